@@ -0,0 +1,274 @@
+/********************************************************************************
+ * Scripted SIM800L module to test and benchmark Arduino-SIM800L-driver        *
+ *                                                                              *
+ * Author: Olivier Staquet                                                      *
+ * Last version available on https://github.com/ostaquet/Arduino-SIM800L-driver *
+ ********************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2019 Olivier Staquet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "MockModem.h"
+
+/**
+ * Answer of the module to a command not expected by the transcript
+ */
+const char MOCK_ERROR[] PROGMEM = "\r\nERROR\r\n";
+
+/**
+ * Load a transcript and restart from its first step
+ */
+void MockModem::load(const MockStep* _script, uint8_t _stepCount) {
+  script = _script;
+  stepCount = _stepCount > MOCK_MAX_STEPS ? MOCK_MAX_STEPS : _stepCount;
+  expectStep = 0;
+  playStep = 0;
+  triggered = 0;
+  playing = NULL;
+  lineSize = 0;
+  skipLF = false;
+  dataLeft = 0;
+  errorsPending = 0;
+  mismatches = 0;
+  scriptedLatency = 0;
+
+  // The first steps without command are played at once (i.e. URC at startup)
+  MockStep step;
+  while(expectStep < stepCount) {
+    loadStep(expectStep, &step);
+    if(step.command != NULL) {
+      break;
+    }
+    if(expectStep == 0) {
+      trigger(0, micros());
+    }
+    expectStep++;
+  }
+}
+
+/**
+ * True if all the steps have been played and read by the driver
+ */
+bool MockModem::isDone() {
+  update();
+  return playStep >= stepCount && playing == NULL && errorsPending == 0;
+}
+
+/**
+ * Number of commands received that didn't match the transcript
+ */
+uint16_t MockModem::getMismatches() {
+  return mismatches;
+}
+
+/**
+ * Latency of the transcript played in microsec: the delays of the steps and
+ * the gaps between the packets (the rest of the time is spent by the driver)
+ */
+uint32_t MockModem::getScriptedLatency() {
+  return scriptedLatency;
+}
+
+/**
+ * Receive a byte from the driver: data expected by the transcript or part of
+ * a command line (checked at the CR)
+ */
+size_t MockModem::write(uint8_t c) {
+  // The data starts after the LF ending the command line
+  if(skipLF) {
+    skipLF = false;
+    if(c == '\n') {
+      return 1;
+    }
+  }
+  if(dataLeft > 0) {
+    dataLeft--;
+    if(dataLeft == 0 && dataStep < stepCount) {
+      trigger(dataStep, micros());
+    }
+    return 1;
+  }
+
+  if(c == '\r') {
+    line[lineSize] = '\0';
+    receiveLine();
+    lineSize = 0;
+  } else if(c != '\n' && lineSize < MOCK_LINE_SIZE - 1) {
+    line[lineSize++] = c;
+  }
+  return 1;
+}
+
+/**
+ * Bytes of the reply released to the driver and not read yet
+ */
+int MockModem::available() {
+  update();
+  return releasedPos - readPos;
+}
+
+/**
+ * Read a byte of the reply (-1 if nothing released yet)
+ */
+int MockModem::read() {
+  update();
+  if(readPos >= releasedPos) {
+    return -1;
+  }
+  return (uint8_t)pgm_read_byte(playing + readPos++);
+}
+
+/**
+ * Next byte of the reply without reading it (-1 if nothing released yet)
+ */
+int MockModem::peek() {
+  update();
+  if(readPos >= releasedPos) {
+    return -1;
+  }
+  return (uint8_t)pgm_read_byte(playing + readPos);
+}
+
+/**
+ * Copy a step of the transcript from PROGMEM
+ */
+void MockModem::loadStep(uint8_t index, MockStep* step) {
+  memcpy_P(step, &script[index], sizeof(MockStep));
+}
+
+/**
+ * Mark a step as ready to be played, its delay starting at time (microsec)
+ */
+void MockModem::trigger(uint8_t index, uint32_t time) {
+  triggered |= (uint32_t)1 << index;
+  triggerTime[index] = time;
+}
+
+/**
+ * A step is played, the next step without command follows it (unless it
+ * waits for the data of the step)
+ */
+void MockModem::followStep(uint32_t time) {
+  if(playStep == 0 || playStep >= stepCount) {
+    return;
+  }
+  MockStep previousStep, step;
+  loadStep(playStep - 1, &previousStep);
+  loadStep(playStep, &step);
+  if(step.command == NULL && previousStep.dataSize == 0) {
+    trigger(playStep, time);
+  }
+}
+
+/**
+ * Check the command line received against the next command of the transcript
+ */
+void MockModem::receiveLine() {
+  if(lineSize == 0) {
+    return;
+  }
+
+  MockStep step;
+  if(expectStep < stepCount) {
+    loadStep(expectStep, &step);
+  }
+  if(expectStep >= stepCount || strncmp_P(line, step.command, strlen_P(step.command)) != 0) {
+    mismatches++;
+    errorsPending++;
+    return;
+  }
+
+  trigger(expectStep, micros());
+  if(step.dataSize > 0) {
+    // The next step is played once the data is received
+    dataLeft = step.dataSize;
+    skipLF = true;
+    dataStep = expectStep + 1;
+  }
+
+  // Next step waiting for a command
+  MockStep nextStep;
+  for(expectStep++; expectStep < stepCount; expectStep++) {
+    loadStep(expectStep, &nextStep);
+    if(nextStep.command != NULL) {
+      break;
+    }
+  }
+}
+
+/**
+ * Start the next reply once its delay is elapsed and release the packets
+ * one by one when the previous one is read
+ */
+void MockModem::update() {
+  uint32_t now = micros();
+
+  // The reply is fully read
+  if(playing != NULL && readPos >= playLength) {
+    if(playing != MOCK_ERROR) {
+      followStep(now);
+    }
+    playing = NULL;
+  }
+
+  if(playing == NULL) {
+    MockStep step;
+    if(errorsPending > 0) {
+      errorsPending--;
+      playing = MOCK_ERROR;
+      playLength = strlen_P(MOCK_ERROR);
+      packetSize = 0;
+    } else if(playStep < stepCount && (triggered & ((uint32_t)1 << playStep)) != 0) {
+      loadStep(playStep, &step);
+      if(now - triggerTime[playStep] < (uint32_t)step.delayMs * 1000) {
+        return;
+      }
+      scriptedLatency += (uint32_t)step.delayMs * 1000;
+      playStep++;
+      if(step.reply == NULL) {
+        // Nothing to send
+        followStep(now);
+        return;
+      }
+      playing = step.reply;
+      playLength = step.replySize > 0 ? step.replySize : strlen_P(step.reply);
+      packetSize = step.packetSize;
+    } else {
+      return;
+    }
+    releasedPos = 0;
+    readPos = 0;
+    releasedAt = now - (uint32_t)MOCK_PACKET_GAP_MS * 1000;
+  }
+
+  // Release the next packet after a short gap
+  if(readPos >= releasedPos && releasedPos < playLength && now - releasedAt >= (uint32_t)MOCK_PACKET_GAP_MS * 1000) {
+    if(releasedPos > 0) {
+      scriptedLatency += (uint32_t)MOCK_PACKET_GAP_MS * 1000;
+    }
+    uint16_t size = playLength - releasedPos;
+    if(packetSize > 0 && size > packetSize) {
+      size = packetSize;
+    }
+    releasedPos += size;
+    releasedAt = now;
+  }
+}
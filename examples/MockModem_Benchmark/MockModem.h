@@ -0,0 +1,102 @@
+/********************************************************************************
+ * Scripted SIM800L module to test and benchmark Arduino-SIM800L-driver        *
+ *                                                                              *
+ * Author: Olivier Staquet                                                      *
+ * Last version available on https://github.com/ostaquet/Arduino-SIM800L-driver *
+ ********************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2019 Olivier Staquet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef _MOCK_MODEM_H_
+#define _MOCK_MODEM_H_
+
+#include <Arduino.h>
+
+#define MOCK_MAX_STEPS 32
+#define MOCK_LINE_SIZE 64
+#define MOCK_PACKET_GAP_MS 2
+
+// Step of a transcript of the module (strings in PROGMEM)
+struct MockStep {
+  const char* command;  // Start of the command expected from the driver (NULL : step played after the previous one)
+  const char* reply;    // Bytes sent by the module, echo included (NULL : nothing)
+  uint16_t delayMs;     // Delay before the reply, from the command (or from the end of the previous step)
+  uint8_t packetSize;   // Reply split in packets of packetSize bytes (0 : in one packet)
+  uint16_t dataSize;    // Bytes of data received after the command (the next step is played once received)
+  uint16_t replySize;   // Size of a reply holding binary data, i.e. \0 (0 : string)
+};
+
+// Stream replaying a transcript of the module to the driver without any hardware
+class MockModem : public Stream {
+  public:
+    // Load a transcript (array of steps in PROGMEM, at most MOCK_MAX_STEPS)
+    void load(const MockStep* _script, uint8_t _stepCount);
+
+    // True if all the steps have been played and read by the driver
+    bool isDone();
+    // Number of commands received that didn't match the transcript (answered by ERROR)
+    uint16_t getMismatches();
+    // Latency of the transcript played in microsec (delays and gaps between the packets)
+    uint32_t getScriptedLatency();
+
+    size_t write(uint8_t c);
+    using Print::write;
+    int available();
+    int read();
+    int peek();
+
+  private:
+    void loadStep(uint8_t index, MockStep* step);
+    void trigger(uint8_t index, uint32_t time);
+    void followStep(uint32_t time);
+    void receiveLine();
+    void update();
+
+    // Transcript and progress of the steps (bit per step triggered)
+    const MockStep* script = NULL;
+    uint8_t stepCount = 0;
+    uint8_t expectStep = 0;
+    uint8_t playStep = 0;
+    uint32_t triggered = 0;
+    uint32_t triggerTime[MOCK_MAX_STEPS];
+
+    // Reply being played (PROGMEM), bytes released to the driver and read
+    const char* playing = NULL;
+    uint16_t playLength = 0;
+    uint16_t releasedPos = 0;
+    uint16_t readPos = 0;
+    uint8_t packetSize = 0;
+    uint32_t releasedAt = 0;
+
+    // Command line or data being received from the driver
+    char line[MOCK_LINE_SIZE];
+    uint8_t lineSize = 0;
+    bool skipLF = false;
+    uint16_t dataLeft = 0;
+    uint8_t dataStep = 0;
+
+    uint16_t errorsPending = 0;
+    uint16_t mismatches = 0;
+    uint32_t scriptedLatency = 0;
+};
+
+#endif // _MOCK_MODEM_H_
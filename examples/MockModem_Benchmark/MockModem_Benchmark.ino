@@ -0,0 +1,915 @@
+/********************************************************************************
+ * Tests and benchmark of Arduino-SIM800L-driver with a scripted module        *
+ *                                                                              *
+ * Author: Olivier Staquet                                                      *
+ * Last version available on https://github.com/ostaquet/Arduino-SIM800L-driver *
+ ********************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2019 Olivier Staquet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "SIM800L.h"
+#include "SIM800LMQTT.h"
+#include "SIM800LPool.h"
+#include "MockModem.h"
+
+// No module needed: the driver talks to MockModem, replaying the transcripts
+// below (echo, URC, packets split, errors and delays of the module), then the
+// results and the cost of each request are written on the Serial.
+// Run it again after a change of the driver to catch the regressions (or on
+// the computer with the host build of the test directory).
+
+#ifndef BENCHMARK_ITERATIONS
+#define BENCHMARK_ITERATIONS 20
+#endif
+
+const char URL[] = "http://postman-echo.com/get";
+const char URL_POST[] = "http://postman-echo.com/post";
+const char CONTENT_TYPE[] = "text/plain";
+const char PAYLOAD[] = "temperature=21.5";
+const char APN[] = "internet";
+const char HOST[] = "example.com";
+
+// Driver exposing the internal methods checked by the tests
+class SIM800LProbe : public SIM800L {
+  public:
+    SIM800LProbe(Stream* _stream, uint16_t _recvBufferSize = 512) : SIM800L(_stream, RESET_PIN_NOT_USED, 200, _recvBufferSize) {}
+    using SIM800L::sendCommand;
+    using SIM800L::readResponse;
+    using SIM800L::strIndex;
+};
+
+/**
+ * Transcripts recorded from a SIM800L (R14.18, echo enabled), the module
+ * answers at least 10ms after the command (the driver purges the serial
+ * right after sending a command)
+ */
+const char CMD_AT[] PROGMEM = "AT";
+const char CMD_ATI[] PROGMEM = "ATI";
+const char CMD_HTTPINIT[] PROGMEM = "AT+HTTPINIT";
+const char CMD_HTTPPARA_CID[] PROGMEM = "AT+HTTPPARA=\"CID\"";
+const char CMD_HTTPPARA_URL[] PROGMEM = "AT+HTTPPARA=\"URL\"";
+const char CMD_HTTPPARA_CONTENT[] PROGMEM = "AT+HTTPPARA=\"CONTENT\"";
+const char CMD_HTTPSSL[] PROGMEM = "AT+HTTPSSL=0";
+const char CMD_HTTPDATA[] PROGMEM = "AT+HTTPDATA=";
+const char CMD_HTTPACTION_GET[] PROGMEM = "AT+HTTPACTION=0";
+const char CMD_HTTPACTION_POST[] PROGMEM = "AT+HTTPACTION=1";
+const char CMD_HTTPACTION_HEAD[] PROGMEM = "AT+HTTPACTION=2";
+const char CMD_HTTPHEAD[] PROGMEM = "AT+HTTPHEAD";
+const char CMD_HTTPREAD[] PROGMEM = "AT+HTTPREAD";
+const char CMD_HTTPREAD_CHUNK_1[] PROGMEM = "AT+HTTPREAD=0,5";
+const char CMD_HTTPREAD_CHUNK_2[] PROGMEM = "AT+HTTPREAD=5,5";
+const char CMD_HTTPREAD_CHUNK_3[] PROGMEM = "AT+HTTPREAD=10,1";
+const char CMD_CSQ[] PROGMEM = "AT+CSQ";
+const char CMD_FSFLSIZE[] PROGMEM = "AT+FSFLSIZE=C:\\USER\\";
+const char CMD_FSCREATE[] PROGMEM = "AT+FSCREATE=C:\\USER\\";
+const char CMD_FSWRITE[] PROGMEM = "AT+FSWRITE=C:\\USER\\log.txt,1,";
+const char CMD_NETWORK[] PROGMEM = "AT+CREG?;+CSQ;+CGATT?";
+const char CMD_COMPACT[] PROGMEM = "ATE0V0";
+const char CMD_VERBOSE[] PROGMEM = "ATE1V1";
+const char CMD_HTTPTERM[] PROGMEM = "AT+HTTPTERM";
+const char CMD_HTTPPARA_USERDATA[] PROGMEM = "AT+HTTPPARA=\"USERDATA\"";
+const char CMD_HTTPREAD_RANGE_2[] PROGMEM = "AT+HTTPREAD=5,1";
+const char CMD_SAPBR2[] PROGMEM = "AT+SAPBR=2,1";
+const char CMD_CREG[] PROGMEM = "AT+CREG?";
+const char CMD_FSREAD[] PROGMEM = "AT+FSREAD=C:\\USER\\log.txt,1,20,0";
+const char CMD_FSDEL[] PROGMEM = "AT+FSDEL=C:\\USER\\log.txt";
+const char CMD_CIPSHUT[] PROGMEM = "AT+CIPSHUT";
+const char CMD_CIPMUX[] PROGMEM = "AT+CIPMUX=0";
+const char CMD_CIPRXGET1[] PROGMEM = "AT+CIPRXGET=1";
+const char CMD_CSTT[] PROGMEM = "AT+CSTT=";
+const char CMD_CIICR[] PROGMEM = "AT+CIICR";
+const char CMD_CIFSR[] PROGMEM = "AT+CIFSR";
+const char CMD_CIPSTART[] PROGMEM = "AT+CIPSTART=";
+const char CMD_CIPSEND[] PROGMEM = "AT+CIPSEND=";
+const char CMD_CIPRXGET2[] PROGMEM = "AT+CIPRXGET=2,";
+const char CMD_CIPCLOSE[] PROGMEM = "AT+CIPCLOSE";
+
+const char RSP_OK[] PROGMEM = "OK";
+const char RSP_AT_OK[] PROGMEM = "AT\r\r\nOK\r\n";
+const char RSP_AT_RING[] PROGMEM = "AT\r\r\nRING\r\n\r\nOK\r\n";
+const char RSP_AT_RING_LINE[] PROGMEM = "AT\r\r\nRING\r\n";
+const char RSP_AT_ERROR[] PROGMEM = "AT\r\r\nERROR\r\n";
+const char RSP_AT_CME_ERROR[] PROGMEM = "AT\r\r\n+CME ERROR: 3\r\n";
+const char RSP_AT_CMS_ERROR[] PROGMEM = "AT\r\r\n+CMS ERROR: 500\r\n";
+const char RSP_ATI[] PROGMEM = "ATI\r\r\nSIM800 R14.18\r\n\r\nOK\r\n";
+const char RSP_HTTPINIT[] PROGMEM = "AT+HTTPINIT\r\r\nOK\r\n";
+const char RSP_HTTPINIT_ERROR[] PROGMEM = "AT+HTTPINIT\r\r\nERROR\r\n";
+const char RSP_HTTPPARA_CID[] PROGMEM = "AT+HTTPPARA=\"CID\",1\r\r\nOK\r\n";
+const char RSP_HTTPPARA_URL[] PROGMEM = "AT+HTTPPARA=\"URL\",\"http://postman-echo.com/get\"\r\r\nOK\r\n";
+const char RSP_HTTPPARA_URL_POST[] PROGMEM = "AT+HTTPPARA=\"URL\",\"http://postman-echo.com/post\"\r\r\nOK\r\n";
+const char RSP_HTTPPARA_CONTENT[] PROGMEM = "AT+HTTPPARA=\"CONTENT\",\"text/plain\"\r\r\nOK\r\n";
+const char RSP_HTTPSSL[] PROGMEM = "AT+HTTPSSL=0\r\r\nOK\r\n";
+const char RSP_HTTPDATA[] PROGMEM = "AT+HTTPDATA=16,10000\r\r\nDOWNLOAD\r\n";
+const char RSP_OK_ALONE[] PROGMEM = "\r\nOK\r\n";
+const char RSP_HTTPACTION_GET[] PROGMEM = "AT+HTTPACTION=0\r\r\nOK\r\n";
+const char RSP_HTTPACTION_GET_LATE[] PROGMEM = "\r\n+HTTPACTION: 0,200,99\r\nAT+HTTPACTION=0\r\r\nOK\r\n";
+const char RSP_HTTPACTION_POST[] PROGMEM = "AT+HTTPACTION=1\r\r\nOK\r\n";
+const char RSP_HTTPACTION_HEAD[] PROGMEM = "AT+HTTPACTION=2\r\r\nOK\r\n";
+const char RSP_HTTPACTION_HEAD_200[] PROGMEM = "\r\n+HTTPACTION: 2,200,1234\r\n";
+const char RSP_HTTPHEAD[] PROGMEM = "AT+HTTPHEAD\r\r\n+HTTPHEAD: 52\r\nHTTP/1.1 200 OK\r\nETag: \"abc\"\r\nContent-Length: 1234\r\n\r\nOK\r\n";
+const char RSP_HTTPACTION_GET_200[] PROGMEM = "\r\n+HTTPACTION: 0,200,11\r\n";
+const char RSP_HTTPACTION_GET_404[] PROGMEM = "\r\n+HTTPACTION: 0,404,0\r\n";
+const char RSP_HTTPACTION_POST_201[] PROGMEM = "\r\n+HTTPACTION: 1,201,0\r\n";
+const char RSP_HTTPREAD[] PROGMEM = "AT+HTTPREAD\r\r\n+HTTPREAD: 11\r\nhello world\r\nOK\r\n";
+const char RSP_HTTPTERM[] PROGMEM = "AT+HTTPTERM\r\r\nOK\r\n";
+const char RSP_RING[] PROGMEM = "\r\nRING\r\n";
+const char RSP_CSQ_URC[] PROGMEM = "AT+CSQ\r\r\n+CMTI: \"SM\",3\r\n+CSQ: 17,0\r\n\r\nRING\r\n\r\nOK\r\n";
+const char RSP_NETWORK_URC[] PROGMEM = "AT+CREG?;+CSQ;+CGATT?\r\r\n+CREG: 0,1\r\n\r\n+CSQ: 17,0\r\n\r\nRING\r\n\r\n+CGATT: 1\r\n\r\nOK\r\n";
+const char RSP_HTTPACTION_GET_BINARY[] PROGMEM = "\r\n+HTTPACTION: 0,200,6\r\n";
+const char RSP_HTTPREAD_BINARY[] PROGMEM = "AT+HTTPREAD\r\r\n+HTTPREAD: 6\r\n\x01\r\n\xff\r\x02\r\nOK\r\n";
+const char RSP_HTTPREAD_CHUNK_1[] PROGMEM = "AT+HTTPREAD=0,5\r\r\n+HTTPREAD: 5\r\nhello\r\nOK\r\n";
+const char RSP_HTTPREAD_CHUNK_2[] PROGMEM = "AT+HTTPREAD=5,5\r\r\n+HTTPREAD: 5\r\n worl\r\nOK\r\n";
+const char RSP_HTTPREAD_CHUNK_3[] PROGMEM = "AT+HTTPREAD=10,1\r\r\n+HTTPREAD: 1\r\nd\r\nOK\r\n";
+
+// Download resumed with a range after a failure of the module (the data is read by chunks of 5 bytes)
+const char RSP_HTTPREAD_CHUNK_2_ERROR[] PROGMEM = "AT+HTTPREAD=5,5\r\r\nERROR\r\n";
+const char RSP_SAPBR2[] PROGMEM = "AT+SAPBR=2,1\r\r\n+SAPBR: 1,1,\"10.0.0.2\"\r\n\r\nOK\r\n";
+const char RSP_HTTPPARA_RANGE[] PROGMEM = "AT+HTTPPARA=\"USERDATA\",\"Range: bytes=5-\"\r\r\nOK\r\n";
+const char RSP_HTTPACTION_GET_206[] PROGMEM = "\r\n+HTTPACTION: 0,206,6\r\n";
+const char RSP_HTTPREAD_RANGE_1[] PROGMEM = "AT+HTTPREAD=0,5\r\r\n+HTTPREAD: 5\r\n worl\r\nOK\r\n";
+const char RSP_HTTPREAD_RANGE_2[] PROGMEM = "AT+HTTPREAD=5,1\r\r\n+HTTPREAD: 1\r\nd\r\nOK\r\n";
+
+// Registration of the modules of a pool and failure of the network (601)
+const char RSP_CREG_HOME[] PROGMEM = "AT+CREG?\r\r\n+CREG: 0,1\r\n\r\nOK\r\n";
+const char RSP_CREG_ROAMING[] PROGMEM = "AT+CREG?\r\r\n+CREG: 0,5\r\n\r\nOK\r\n";
+const char RSP_CREG_SEARCHING[] PROGMEM = "AT+CREG?\r\r\n+CREG: 0,2\r\n\r\nOK\r\n";
+const char RSP_HTTPACTION_GET_601[] PROGMEM = "\r\n+HTTPACTION: 0,601,0\r\n";
+
+// Compact mode: no echo and numeric result codes (0 for OK)
+const char RSP_COMPACT[] PROGMEM = "ATE0V0\r0\r";
+const char RSP_COMPACT_OK[] PROGMEM = "0\r";
+const char RSP_COMPACT_ERROR[] PROGMEM = "4\r";
+const char RSP_COMPACT_CSQ[] PROGMEM = "+CSQ: 17,0\r\n0\r";
+const char RSP_COMPACT_HTTPACTION_GET_200[] PROGMEM = "+HTTPACTION: 0,200,11\r\n";
+const char RSP_COMPACT_HTTPREAD[] PROGMEM = "+HTTPREAD: 11\r\nhello world\r\n0\r";
+const char RSP_VERBOSE[] PROGMEM = "\r\nOK\r\n";
+
+// File system of the module (store-and-forward in C:\USER\log.txt)
+const char RSP_FSFLSIZE_ERROR[] PROGMEM = "AT+FSFLSIZE=C:\\USER\\log.txt\r\r\nERROR\r\n";
+const char RSP_FSCREATE[] PROGMEM = "AT+FSCREATE=C:\\USER\\log.txt\r\r\nOK\r\n";
+const char RSP_FSFLSIZE_NEW_ERROR[] PROGMEM = "AT+FSFLSIZE=C:\\USER\\new.txt\r\r\nERROR\r\n";
+const char RSP_FSCREATE_NEW_ERROR[] PROGMEM = "AT+FSCREATE=C:\\USER\\new.txt\r\r\nERROR\r\n";
+const char RSP_FSWRITE_10[] PROGMEM = "AT+FSWRITE=C:\\USER\\log.txt,1,10,10\r\r\n>";
+const char RSP_FSFLSIZE_20[] PROGMEM = "AT+FSFLSIZE=C:\\USER\\log.txt\r\r\n+FSFLSIZE: 20\r\n\r\nOK\r\n";
+const char RSP_FSREAD[] PROGMEM = "AT+FSREAD=C:\\USER\\log.txt,1,20,0\r\r\ntemp=21.5\ntemp=21.5\n\r\nOK\r\n";
+const char RSP_HTTPDATA_20[] PROGMEM = "AT+HTTPDATA=20,10000\r\r\nDOWNLOAD\r\n";
+const char RSP_HTTPACTION_POST_200[] PROGMEM = "\r\n+HTTPACTION: 1,200,0\r\n";
+const char RSP_FSDEL[] PROGMEM = "AT+FSDEL=C:\\USER\\log.txt\r\r\nOK\r\n";
+const char RECORD[] = "temp=21.5";
+
+// Raw socket in single connection mode, the data received is read with AT+CIPRXGET
+const char RSP_CIPSHUT[] PROGMEM = "AT+CIPSHUT\r\r\nSHUT OK\r\n";
+const char RSP_CIPMUX[] PROGMEM = "AT+CIPMUX=0\r\r\nOK\r\n";
+const char RSP_CIPRXGET1[] PROGMEM = "AT+CIPRXGET=1\r\r\nOK\r\n";
+const char RSP_CSTT[] PROGMEM = "AT+CSTT=\"internet\"\r\r\nOK\r\n";
+const char RSP_CIICR[] PROGMEM = "AT+CIICR\r\r\nOK\r\n";
+const char RSP_CIFSR[] PROGMEM = "AT+CIFSR\r\r\n10.0.0.2\r\n";
+const char RSP_CIPSTART[] PROGMEM = "AT+CIPSTART=\"TCP\",\"example.com\",80\r\r\nOK\r\n";
+const char RSP_CIPSTART_MQTT[] PROGMEM = "AT+CIPSTART=\"TCP\",\"example.com\",1883\r\r\nOK\r\n";
+const char RSP_CONNECT_OK[] PROGMEM = "\r\nCONNECT OK\r\n";
+const char RSP_CIPSEND_5[] PROGMEM = "AT+CIPSEND=5\r\r\n> ";
+const char RSP_SEND_OK[] PROGMEM = "\r\nSEND OK\r\n";
+const char RSP_CIPRXGET_URC[] PROGMEM = "\r\n+CIPRXGET: 1\r\n";
+const char RSP_CIPRXGET2[] PROGMEM = "AT+CIPRXGET=2,16\r\r\n+CIPRXGET: 2,5,0\r\nhello\r\nOK\r\n";
+const char RSP_CIPCLOSE[] PROGMEM = "AT+CIPCLOSE\r\r\nCLOSE OK\r\n";
+
+// MQTT session of the client "sim800l": CONNECT (21 bytes), PUBLISH with QoS 1 (22 bytes)
+// and DISCONNECT (2 bytes), the acknowledgements of the broker hold \0
+const char RSP_CIPSEND_21[] PROGMEM = "AT+CIPSEND=21\r\r\n> ";
+const char RSP_CIPSEND_22[] PROGMEM = "AT+CIPSEND=22\r\r\n> ";
+const char RSP_CIPSEND_2[] PROGMEM = "AT+CIPSEND=2\r\r\n> ";
+const char RSP_CIPRXGET2_CONNACK[] PROGMEM = "AT+CIPRXGET=2,128\r\r\n+CIPRXGET: 2,4,0\r\n\x20\x02\x00\x00\r\nOK\r\n";
+const char RSP_CIPRXGET2_PUBACK[] PROGMEM = "AT+CIPRXGET=2,128\r\r\n+CIPRXGET: 2,4,0\r\n\x40\x02\x00\x01\r\nOK\r\n";
+
+// Binary data (0x01 CR LF 0xFF CR 0x02)
+const char BINARY_DATA[] = "\x01\r\n\xff\r\x02";
+
+// Answer split in packets of 3 bytes
+const MockStep SCRIPT_SPLIT[] PROGMEM = {
+  {CMD_AT, RSP_AT_OK, 10, 3, 0, 0}
+};
+
+// Unsolicited message before the answer
+const MockStep SCRIPT_URC[] PROGMEM = {
+  {CMD_AT, RSP_AT_RING, 10, 0, 0, 0}
+};
+
+// Unsolicited messages in the middle of the answer
+const MockStep SCRIPT_URC_INTERLEAVED[] PROGMEM = {
+  {CMD_CSQ, RSP_CSQ_URC, 10, 5, 0, 0}
+};
+
+// Unsolicited message between the answers of a chained command
+const MockStep SCRIPT_NETWORK_URC[] PROGMEM = {
+  {CMD_NETWORK, RSP_NETWORK_URC, 10, 7, 0, 0}
+};
+
+// Unsolicited message in an answer read up to the CRLF (no final OK)
+const MockStep SCRIPT_URC_CRLF[] PROGMEM = {
+  {CMD_AT, RSP_AT_RING_LINE, 10, 0, 0, 0}
+};
+
+// Error of the module
+const MockStep SCRIPT_ERROR[] PROGMEM = {
+  {CMD_AT, RSP_AT_ERROR, 10, 0, 0, 0}
+};
+
+// Errors of the equipment and of the SMS service
+const MockStep SCRIPT_CME_ERROR[] PROGMEM = {
+  {CMD_AT, RSP_AT_CME_ERROR, 10, 0, 0, 0}
+};
+
+const MockStep SCRIPT_CMS_ERROR[] PROGMEM = {
+  {CMD_AT, RSP_AT_CMS_ERROR, 10, 0, 0, 0}
+};
+
+// Answer arriving after the timeout
+const MockStep SCRIPT_LATE[] PROGMEM = {
+  {CMD_AT, RSP_AT_OK, 300, 0, 0, 0}
+};
+
+// Model and firmware of the module (probed once by the driver)
+const MockStep SCRIPT_PROBE[] PROGMEM = {
+  {CMD_ATI, RSP_ATI, 10, 0, 0, 0}
+};
+
+// GET with the server answering after 300ms and the data read in packets of 16 bytes
+const MockStep SCRIPT_GET[] PROGMEM = {
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPACTION_GET, RSP_HTTPACTION_GET, 10, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_GET_200, 300, 8, 0, 0},
+  {CMD_HTTPREAD, RSP_HTTPREAD, 10, 16, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0}
+};
+
+// GET with a RING while waiting for the server, answering 404 without data
+const MockStep SCRIPT_GET_404[] PROGMEM = {
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPACTION_GET, RSP_HTTPACTION_GET, 10, 0, 0, 0},
+  {NULL, RSP_RING, 100, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_GET_404, 200, 0, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0}
+};
+
+// GET of binary data kept as is in the reception buffer
+const MockStep SCRIPT_GET_BINARY[] PROGMEM = {
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPACTION_GET, RSP_HTTPACTION_GET, 10, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_GET_BINARY, 100, 0, 0, 0},
+  {CMD_HTTPREAD, RSP_HTTPREAD_BINARY, 10, 4, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0}
+};
+
+// GET read by chunks of 5 bytes (reception buffer of 6 bytes)
+const MockStep SCRIPT_GET_CHUNKS[] PROGMEM = {
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPACTION_GET, RSP_HTTPACTION_GET, 10, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_GET_200, 100, 0, 0, 0},
+  {CMD_HTTPREAD_CHUNK_1, RSP_HTTPREAD_CHUNK_1, 10, 8, 0, 0},
+  {CMD_HTTPREAD_CHUNK_2, RSP_HTTPREAD_CHUNK_2, 10, 8, 0, 0},
+  {CMD_HTTPREAD_CHUNK_3, RSP_HTTPREAD_CHUNK_3, 10, 8, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0}
+};
+
+// Compact mode enabled, signal and GET without echo, then back to the verbose mode
+const MockStep SCRIPT_COMPACT[] PROGMEM = {
+  {CMD_COMPACT, RSP_COMPACT, 10, 0, 0, 0},
+  {CMD_CSQ, RSP_COMPACT_CSQ, 10, 0, 0, 0},
+  {CMD_HTTPINIT, RSP_COMPACT_OK, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_COMPACT_OK, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_COMPACT_OK, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_COMPACT_OK, 10, 0, 0, 0},
+  {CMD_HTTPACTION_GET, RSP_COMPACT_OK, 10, 0, 0, 0},
+  {NULL, RSP_COMPACT_HTTPACTION_GET_200, 100, 0, 0, 0},
+  {CMD_HTTPREAD, RSP_COMPACT_HTTPREAD, 10, 0, 0, 0},
+  {CMD_HTTPTERM, RSP_COMPACT_OK, 10, 0, 0, 0},
+  {CMD_VERBOSE, RSP_VERBOSE, 10, 0, 0, 0}
+};
+
+// Records appended to a new file, the file is created only before the first record
+const MockStep SCRIPT_STORE[] PROGMEM = {
+  {CMD_FSFLSIZE, RSP_FSFLSIZE_ERROR, 10, 0, 0, 0},
+  {CMD_FSCREATE, RSP_FSCREATE, 10, 0, 0, 0},
+  {CMD_FSWRITE, RSP_FSWRITE_10, 10, 0, 10, 0},
+  {NULL, RSP_OK_ALONE, 20, 0, 0, 0},
+  {CMD_FSWRITE, RSP_FSWRITE_10, 10, 0, 10, 0},
+  {NULL, RSP_OK_ALONE, 20, 0, 0, 0}
+};
+
+// File which can't be created (i.e. file system full), nothing is written
+const MockStep SCRIPT_STORE_ERROR[] PROGMEM = {
+  {CMD_FSFLSIZE, RSP_FSFLSIZE_NEW_ERROR, 10, 0, 0, 0},
+  {CMD_FSCREATE, RSP_FSCREATE_NEW_ERROR, 10, 0, 0, 0}
+};
+
+// Error in compact mode (numeric result code 4)
+const MockStep SCRIPT_COMPACT_ERROR[] PROGMEM = {
+  {CMD_COMPACT, RSP_COMPACT, 10, 0, 0, 0},
+  {CMD_AT, RSP_COMPACT_ERROR, 10, 0, 0, 0},
+  {CMD_VERBOSE, RSP_VERBOSE, 10, 0, 0, 0}
+};
+
+// Queue of a GET and a POST sent back-to-back in one session (only the URL and the content type are defined again)
+const MockStep SCRIPT_QUEUE[] PROGMEM = {
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPACTION_GET, RSP_HTTPACTION_GET, 10, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_GET_200, 100, 0, 0, 0},
+  {CMD_HTTPREAD, RSP_HTTPREAD, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL_POST, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CONTENT, RSP_HTTPPARA_CONTENT, 10, 0, 0, 0},
+  {CMD_HTTPDATA, RSP_HTTPDATA, 10, 0, 16, 0},
+  {NULL, RSP_OK_ALONE, 20, 0, 0, 0},
+  {CMD_HTTPACTION_POST, RSP_HTTPACTION_POST, 10, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_POST_201, 100, 0, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0}
+};
+
+// GET with the late answer of a previous request received while sending the
+// action (first packet, read by the purge of the driver right after the command)
+const MockStep SCRIPT_GET_LATE_ACTION[] PROGMEM = {
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPACTION_GET, RSP_HTTPACTION_GET_LATE, 0, 25, 0, 0},
+  {NULL, RSP_HTTPACTION_GET_404, 100, 0, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0}
+};
+
+// HEAD with the headers read in a buffer (AT+HTTPHEAD, starting with the status line)
+const MockStep SCRIPT_HEAD[] PROGMEM = {
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPACTION_HEAD, RSP_HTTPACTION_HEAD, 10, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_HEAD_200, 100, 0, 0, 0},
+  {CMD_HTTPHEAD, RSP_HTTPHEAD, 10, 16, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0}
+};
+
+// GET refused by the module
+const MockStep SCRIPT_GET_ERROR[] PROGMEM = {
+  {CMD_HTTPINIT, RSP_HTTPINIT_ERROR, 10, 0, 0, 0}
+};
+
+// POST of the payload, the server answering 201 after 400ms
+const MockStep SCRIPT_POST[] PROGMEM = {
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL_POST, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CONTENT, RSP_HTTPPARA_CONTENT, 10, 0, 0, 0},
+  {CMD_HTTPDATA, RSP_HTTPDATA, 10, 0, 16, 0},
+  {NULL, RSP_OK_ALONE, 20, 0, 0, 0},
+  {CMD_HTTPACTION_POST, RSP_HTTPACTION_POST, 10, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_POST_201, 400, 0, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0}
+};
+
+// Download failing on the second chunk, then resumed from the byte 5 (206)
+const MockStep SCRIPT_DOWNLOAD[] PROGMEM = {
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPACTION_GET, RSP_HTTPACTION_GET, 10, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_GET_200, 100, 0, 0, 0},
+  {CMD_HTTPREAD_CHUNK_1, RSP_HTTPREAD_CHUNK_1, 10, 0, 0, 0},
+  {CMD_HTTPREAD_CHUNK_2, RSP_HTTPREAD_CHUNK_2_ERROR, 10, 0, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0},
+  {CMD_SAPBR2, RSP_SAPBR2, 10, 0, 0, 0},
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL, 10, 0, 0, 0},
+  {CMD_HTTPPARA_USERDATA, RSP_HTTPPARA_RANGE, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPACTION_GET, RSP_HTTPACTION_GET, 10, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_GET_206, 100, 0, 0, 0},
+  {CMD_HTTPREAD_CHUNK_1, RSP_HTTPREAD_RANGE_1, 10, 0, 0, 0},
+  {CMD_HTTPREAD_RANGE_2, RSP_HTTPREAD_RANGE_2, 10, 0, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0}
+};
+
+// Records of C:\USER\log.txt read and posted in one part, then the file is deleted
+const MockStep SCRIPT_POST_STORED[] PROGMEM = {
+  {CMD_FSFLSIZE, RSP_FSFLSIZE_20, 10, 0, 0, 0},
+  {CMD_FSREAD, RSP_FSREAD, 10, 0, 0, 0},
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL_POST, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CONTENT, RSP_HTTPPARA_CONTENT, 10, 0, 0, 0},
+  {CMD_HTTPDATA, RSP_HTTPDATA_20, 10, 0, 20, 0},
+  {NULL, RSP_OK_ALONE, 20, 0, 0, 0},
+  {CMD_HTTPACTION_POST, RSP_HTTPACTION_POST, 10, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_POST_200, 100, 0, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0},
+  {CMD_FSDEL, RSP_FSDEL, 10, 0, 0, 0}
+};
+
+// IP context, TCP connection, 5 bytes sent and 5 bytes received after +CIPRXGET: 1
+const MockStep SCRIPT_SOCKET[] PROGMEM = {
+  {CMD_CIPSHUT, RSP_CIPSHUT, 10, 0, 0, 0},
+  {CMD_CIPMUX, RSP_CIPMUX, 10, 0, 0, 0},
+  {CMD_CIPRXGET1, RSP_CIPRXGET1, 10, 0, 0, 0},
+  {CMD_CSTT, RSP_CSTT, 10, 0, 0, 0},
+  {CMD_CIICR, RSP_CIICR, 10, 0, 0, 0},
+  {CMD_CIFSR, RSP_CIFSR, 10, 0, 0, 0},
+  {CMD_CIPSTART, RSP_CIPSTART, 10, 0, 0, 0},
+  {NULL, RSP_CONNECT_OK, 100, 0, 0, 0},
+  {CMD_CIPSEND, RSP_CIPSEND_5, 10, 0, 5, 0},
+  {NULL, RSP_SEND_OK, 20, 0, 0, 0},
+  {NULL, RSP_CIPRXGET_URC, 50, 0, 0, 0},
+  {CMD_CIPRXGET2, RSP_CIPRXGET2, 10, 0, 0, 0},
+  {CMD_CIPCLOSE, RSP_CIPCLOSE, 10, 0, 0, 0}
+};
+
+// MQTT session over the IP context: CONNECT/CONNACK, PUBLISH/PUBACK and DISCONNECT
+const MockStep SCRIPT_MQTT[] PROGMEM = {
+  {CMD_CIPSTART, RSP_CIPSTART_MQTT, 10, 0, 0, 0},
+  {NULL, RSP_CONNECT_OK, 100, 0, 0, 0},
+  {CMD_CIPSEND, RSP_CIPSEND_21, 10, 0, 21, 0},
+  {NULL, RSP_SEND_OK, 20, 0, 0, 0},
+  {NULL, RSP_CIPRXGET_URC, 50, 0, 0, 0},
+  {CMD_CIPRXGET2, RSP_CIPRXGET2_CONNACK, 10, 0, 0, sizeof(RSP_CIPRXGET2_CONNACK) - 1},
+  {CMD_CIPSEND, RSP_CIPSEND_22, 10, 0, 22, 0},
+  {NULL, RSP_SEND_OK, 20, 0, 0, 0},
+  {NULL, RSP_CIPRXGET_URC, 50, 0, 0, 0},
+  {CMD_CIPRXGET2, RSP_CIPRXGET2_PUBACK, 10, 0, 0, sizeof(RSP_CIPRXGET2_PUBACK) - 1},
+  {CMD_CIPSEND, RSP_CIPSEND_2, 10, 0, 2, 0},
+  {NULL, RSP_SEND_OK, 20, 0, 0, 0},
+  {CMD_CIPCLOSE, RSP_CIPCLOSE, 10, 0, 0, 0}
+};
+
+// First module of a pool: registered, GET failed by the network (601), then not registered any more
+const MockStep SCRIPT_POOL_FAILED[] PROGMEM = {
+  {CMD_CREG, RSP_CREG_HOME, 10, 0, 0, 0},
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPACTION_GET, RSP_HTTPACTION_GET, 10, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_GET_601, 100, 0, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0},
+  {CMD_CREG, RSP_CREG_SEARCHING, 10, 0, 0, 0}
+};
+
+// Second module of the pool: registered (roaming), the GET is sent again by this module
+const MockStep SCRIPT_POOL_RETRY[] PROGMEM = {
+  {CMD_CREG, RSP_CREG_ROAMING, 10, 0, 0, 0},
+  {CMD_HTTPINIT, RSP_HTTPINIT, 10, 0, 0, 0},
+  {CMD_HTTPPARA_CID, RSP_HTTPPARA_CID, 10, 0, 0, 0},
+  {CMD_HTTPPARA_URL, RSP_HTTPPARA_URL, 10, 0, 0, 0},
+  {CMD_HTTPSSL, RSP_HTTPSSL, 10, 0, 0, 0},
+  {CMD_HTTPACTION_GET, RSP_HTTPACTION_GET, 10, 0, 0, 0},
+  {NULL, RSP_HTTPACTION_GET_200, 100, 0, 0, 0},
+  {CMD_HTTPREAD, RSP_HTTPREAD, 10, 0, 0, 0},
+  {CMD_HTTPTERM, RSP_HTTPTERM, 10, 0, 0, 0}
+};
+
+#define STEPS(script) script, sizeof(script) / sizeof(MockStep)
+
+MockModem mockModem;
+SIM800LProbe* sim800l;
+
+// Second module, for the pool
+MockModem poolModem;
+
+uint8_t testsPassed = 0;
+uint8_t testsFailed = 0;
+uint8_t ringReceived = 0;
+uint8_t smsReceived = 0;
+uint8_t signalReceived = 0;
+uint16_t idleWhileWaitingServer = 0;
+char chunksReceived[16];
+uint8_t chunkCount = 0;
+uint8_t queueSucceeded = 0;
+SIM800L* queuedBy = NULL;
+
+// Tests and benchmark (declared for the builds without the prototypes generated by the Arduino IDE)
+void onRing(SIM800L* sim800l, const char* urc);
+void onSMS(SIM800L* sim800l, const char* urc);
+void onSignal(SIM800L* sim800l, const char* urc);
+void onIdle(SIM800L* sim800l);
+void onChunk(SIM800L* sim800l, const char* data, uint16_t size, uint32_t offset);
+void onQueuedRequest(SIM800L* sim800l, const HTTPRequest* request, uint16_t httpRC);
+void check(const __FlashStringHelper* name, bool passed);
+bool finishScript(MockModem* modem = &mockModem);
+void testStrIndex();
+void testReadResponse();
+void testHTTP();
+void testDataModes();
+void testCompactMode();
+void testQueue();
+void testStoreAndForward();
+void testDownload();
+void testSockets();
+void testPool();
+void benchmark(const __FlashStringHelper* name, bool post);
+
+void onRing(SIM800L*, const char*) {
+  ringReceived++;
+}
+
+void onSMS(SIM800L*, const char*) {
+  smsReceived++;
+}
+
+// The answers to the commands of the driver must not reach the handlers
+void onSignal(SIM800L*, const char*) {
+  signalReceived++;
+}
+
+// Calls of the idle hook while the server is preparing its answer
+void onIdle(SIM800L* sim800l) {
+  if(sim800l->getHTTPState() == HTTP_WAIT_RESPONSE) {
+    idleWhileWaitingServer++;
+  }
+}
+
+// Chunks of the response collected in order
+void onChunk(SIM800L*, const char* data, uint16_t size, uint32_t offset) {
+  if(offset + size < sizeof(chunksReceived)) {
+    memcpy(&chunksReceived[offset], data, size);
+    chunksReceived[offset + size] = '\0';
+  }
+  chunkCount++;
+}
+
+// Results of the queues with the module which sent the request
+void onQueuedRequest(SIM800L* module, const HTTPRequest*, uint16_t httpRC) {
+  if(httpRC >= 200 && httpRC < 300) {
+    queueSucceeded++;
+  }
+  queuedBy = module;
+}
+
+void setup() {
+  // Initialize Serial Monitor for the results
+  Serial.begin(115200);
+  while(!Serial);
+
+  // Initialize SIM800L driver on the scripted module, debug disabled
+  sim800l = new SIM800LProbe(&mockModem);
+  sim800l->addURCHandler("RING", onRing);
+  sim800l->addURCHandler("+CMTI", onSMS);
+  sim800l->addURCHandler("+CSQ", onSignal);
+
+  Serial.println(F("Tests"));
+  testStrIndex();
+  testReadResponse();
+  testHTTP();
+  testDataModes();
+  testCompactMode();
+  testQueue();
+  testStoreAndForward();
+  testDownload();
+  testSockets();
+  testPool();
+  Serial.print(testsPassed);
+  Serial.print(F(" passed, "));
+  Serial.print(testsFailed);
+  Serial.println(F(" failed"));
+
+  Serial.println(F("Benchmark"));
+  benchmark(F("GET"), false);
+  benchmark(F("POST"), true);
+}
+
+void loop() {
+}
+
+/**
+ * Write the result of a test
+ */
+void check(const __FlashStringHelper* name, bool passed) {
+  Serial.print(passed ? F("  PASS ") : F("  FAIL "));
+  Serial.println(name);
+  if(passed) {
+    testsPassed++;
+  } else {
+    testsFailed++;
+  }
+}
+
+/**
+ * Let the scripted module play the rest of the transcript (i.e. after a
+ * timeout of the driver), true if it was fully played without mismatch
+ */
+bool finishScript(MockModem* modem) {
+  uint32_t timerStart = millis();
+  while(!modem->isDone() && millis() - timerStart < 2000) {
+    while(modem->available()) {
+      modem->read();
+    }
+  }
+  return modem->isDone() && modem->getMismatches() == 0;
+}
+
+void testStrIndex() {
+  check(F("strIndex() found"), sim800l->strIndex("+HTTPACTION: 0,200,5", "200") == 15);
+  check(F("strIndex() from index"), sim800l->strIndex("OK\r\nOK", "OK", 1) == 4);
+  check(F("strIndex() not found"), sim800l->strIndex("ERROR", "OK") == -1);
+  check(F("strIndex() index out of string"), sim800l->strIndex("OK", "OK", 3) == -1);
+}
+
+void testReadResponse() {
+  mockModem.load(STEPS(SCRIPT_SPLIT));
+  sim800l->sendCommand("AT");
+  check(F("readResponse() packets split"), sim800l->readResponse(500, 2, RSP_OK) && finishScript());
+
+  mockModem.load(STEPS(SCRIPT_URC));
+  ringReceived = 0;
+  sim800l->sendCommand("AT");
+  check(F("readResponse() URC before the answer"), sim800l->readResponse(500, 2, RSP_OK) && finishScript() && ringReceived == 1);
+
+  mockModem.load(STEPS(SCRIPT_URC_INTERLEAVED));
+  ringReceived = 0;
+  smsReceived = 0;
+  signalReceived = 0;
+  uint8_t signal = sim800l->getSignal();
+  check(F("getSignal() URC in the answer"), signal == 17 && finishScript() && ringReceived == 1 && smsReceived == 1 && signalReceived == 0);
+
+  mockModem.load(STEPS(SCRIPT_NETWORK_URC));
+  ringReceived = 0;
+  NetworkSnapshot snapshot = sim800l->getNetworkSnapshot();
+  check(F("getNetworkSnapshot() URC between the answers"), snapshot.ready && finishScript() && ringReceived == 1 && signalReceived == 0);
+
+  mockModem.load(STEPS(SCRIPT_URC_CRLF));
+  ringReceived = 0;
+  sim800l->sendCommand("AT");
+  check(F("readResponse() URC up to the CRLF"), sim800l->readResponse(500, 2) && finishScript() && ringReceived == 1);
+
+  mockModem.load(STEPS(SCRIPT_ERROR));
+  sim800l->sendCommand("AT");
+  check(F("readResponse() ERROR"), !sim800l->readResponse(500, 2, RSP_OK) && finishScript());
+
+  // The errors are detected at once, without waiting for the timeout
+  mockModem.load(STEPS(SCRIPT_CME_ERROR));
+  sim800l->sendCommand("AT");
+  uint32_t timerStart = millis();
+  check(F("readResponse() +CME ERROR"), !sim800l->readResponse(2000, 2, RSP_OK) && millis() - timerStart < 1000 && finishScript());
+
+  mockModem.load(STEPS(SCRIPT_CMS_ERROR));
+  sim800l->sendCommand("AT");
+  timerStart = millis();
+  check(F("readResponse() +CMS ERROR"), !sim800l->readResponse(2000, 2, RSP_OK) && millis() - timerStart < 1000 && finishScript());
+
+  mockModem.load(STEPS(SCRIPT_LATE));
+  sim800l->sendCommand("AT");
+  check(F("readResponse() timeout"), !sim800l->readResponse(100, 2, RSP_OK) && finishScript());
+}
+
+void testHTTP() {
+  mockModem.load(STEPS(SCRIPT_PROBE));
+  check(F("getModel()"), strcmp(sim800l->getModel(), "SIM800") == 0 && finishScript());
+
+  mockModem.load(STEPS(SCRIPT_GET));
+  sim800l->setIdleHook(onIdle);
+  idleWhileWaitingServer = 0;
+  uint16_t rc = sim800l->doGet(URL, 2000);
+  sim800l->setIdleHook(NULL);
+  check(F("doGet() 200"), rc == 200 && strcmp(sim800l->getDataReceived(), "hello world") == 0 && finishScript());
+  check(F("doGet() idle hook while waiting for the server"), idleWhileWaitingServer > 0);
+
+  mockModem.load(STEPS(SCRIPT_GET_404));
+  ringReceived = 0;
+  rc = sim800l->doGet(URL, 2000);
+  check(F("doGet() 404 with URC"), rc == 404 && ringReceived == 1 && finishScript());
+
+  mockModem.load(STEPS(SCRIPT_GET_LATE_ACTION));
+  rc = sim800l->doGet(URL, 2000);
+  check(F("doGet() late answer of a previous request"), rc == 404 && finishScript());
+
+  // The first line of the buffer is the first header, the status line is dropped
+  char headers[64];
+  sim800l->setHTTPHeadersBuffer(headers, sizeof(headers));
+  mockModem.load(STEPS(SCRIPT_HEAD));
+  rc = sim800l->doHead(URL, NULL, 2000);
+  const char* etag = sim800l->getHTTPHeader("ETag");
+  const char* contentLength = sim800l->getHTTPHeader("content-length");
+  sim800l->setHTTPHeadersBuffer(NULL, 0);
+  check(F("doHead() headers"), rc == 200 && strcmp(headers, "ETag: \"abc\"") == 0 && etag != NULL && strcmp(etag, "\"abc\"") == 0 &&
+        contentLength != NULL && strcmp(contentLength, "1234") == 0 && finishScript());
+
+  mockModem.load(STEPS(SCRIPT_GET_ERROR));
+  rc = sim800l->doGet(URL, 2000);
+  check(F("doGet() refused"), rc == 701 && finishScript());
+
+  mockModem.load(STEPS(SCRIPT_POST));
+  rc = sim800l->doPost(URL_POST, CONTENT_TYPE, PAYLOAD, 10000, 2000);
+  check(F("doPost() 201"), rc == 201 && finishScript());
+}
+
+void testDataModes() {
+  mockModem.load(STEPS(SCRIPT_GET_BINARY));
+  sim800l->setBinaryMode(true);
+  uint16_t rc = sim800l->doGet(URL, 2000);
+  sim800l->setBinaryMode(false);
+  check(F("doGet() binary data"), rc == 200 && sim800l->getDataSizeReceived() == 6 && memcmp(sim800l->getDataReceived(), BINARY_DATA, 6) == 0 && finishScript());
+
+  // Small reception buffer, the response is read by chunks given to the callback
+  SIM800LProbe chunkProbe(&mockModem, 6);
+  mockModem.load(STEPS(SCRIPT_PROBE));
+  chunkProbe.getModel();
+  finishScript();
+  mockModem.load(STEPS(SCRIPT_GET_CHUNKS));
+  chunkProbe.setHTTPDataCallback(onChunk);
+  chunksReceived[0] = '\0';
+  chunkCount = 0;
+  rc = chunkProbe.doGet(URL, 2000);
+  check(F("doGet() by chunks"), rc == 200 && chunkCount == 3 && strcmp(chunksReceived, "hello world") == 0 && finishScript());
+}
+
+void testCompactMode() {
+  mockModem.load(STEPS(SCRIPT_COMPACT));
+  bool enabled = sim800l->enableCompactMode();
+  uint8_t signal = sim800l->getSignal();
+  uint16_t rc = sim800l->doGet(URL, 2000);
+  bool dataReceived = rc == 200 && strcmp(sim800l->getDataReceived(), "hello world") == 0;
+  bool disabled = sim800l->disableCompactMode();
+  check(F("compact mode"), enabled && signal == 17 && dataReceived && disabled && finishScript());
+
+  mockModem.load(STEPS(SCRIPT_COMPACT_ERROR));
+  enabled = sim800l->enableCompactMode();
+  sim800l->sendCommand("AT");
+  uint32_t timerStart = millis();
+  bool failed = !sim800l->readResponse(2000, 2, RSP_OK) && millis() - timerStart < 1000;
+  disabled = sim800l->disableCompactMode();
+  check(F("compact mode error"), enabled && failed && disabled && finishScript());
+}
+
+void testQueue() {
+  HTTPRequest queue[2];
+  sim800l->setHTTPQueue(queue, 2);
+  sim800l->setHTTPQueueCallback(onQueuedRequest);
+  queueSucceeded = 0;
+  bool queued = sim800l->queueGet(URL, NULL, 2000) && sim800l->queuePost(URL_POST, NULL, CONTENT_TYPE, PAYLOAD, 10000, 2000);
+  check(F("queueGet() and queuePost() full"), queued && !sim800l->queueGet(URL, NULL, 2000));
+
+  mockModem.load(STEPS(SCRIPT_QUEUE));
+  uint8_t succeeded = sim800l->sendQueue();
+  check(F("sendQueue() in one session"), succeeded == 2 && queueSucceeded == 2 && sim800l->getQueueLength() == 0 && finishScript());
+  sim800l->setHTTPQueue(NULL, 0);
+  sim800l->setHTTPQueueCallback(NULL);
+}
+
+void testStoreAndForward() {
+  mockModem.load(STEPS(SCRIPT_STORE));
+  bool stored = sim800l->storeRecord("log.txt", RECORD) && sim800l->storeRecord("log.txt", RECORD);
+  check(F("storeRecord() file created once"), stored && finishScript());
+
+  mockModem.load(STEPS(SCRIPT_STORE_ERROR));
+  stored = sim800l->storeRecord("new.txt", RECORD);
+  check(F("storeRecord() file not created"), !stored && finishScript());
+
+  mockModem.load(STEPS(SCRIPT_POST_STORED));
+  uint16_t rc = sim800l->postStored(URL_POST, NULL, CONTENT_TYPE, "log.txt", 10000, 2000);
+  check(F("postStored() records posted and deleted"), rc == 200 && finishScript());
+}
+
+void testDownload() {
+  // Chunks of 5 bytes, the second chunk of the first attempt fails
+  SIM800LProbe downloadProbe(&mockModem, 6);
+  mockModem.load(STEPS(SCRIPT_PROBE));
+  downloadProbe.getModel();
+  finishScript();
+  mockModem.load(STEPS(SCRIPT_DOWNLOAD));
+  downloadProbe.setHTTPDataCallback(onChunk);
+  chunksReceived[0] = '\0';
+  chunkCount = 0;
+  uint16_t rc = downloadProbe.doDownload(URL, 0, 2000);
+  check(F("doDownload() resumed with a range"), rc == 206 && chunkCount == 3 && strcmp(chunksReceived, "hello world") == 0 &&
+        downloadProbe.getDownloadOffset() == 11 && downloadProbe.getDownloadSize() == 11 && finishScript());
+}
+
+void testSockets() {
+  mockModem.load(STEPS(SCRIPT_SOCKET));
+  bool ready = sim800l->setupIP(APN);
+  bool connected = ready && sim800l->connectSocket(0, SOCKET_TCP, HOST, 80, 2000);
+  bool sent = connected && sim800l->sendSocket(0, (const uint8_t*)"hello", 5, 2000);
+  check(F("setupIP(), connectSocket() and sendSocket()"), sent && sim800l->getSocketState(0) == SOCKET_CONNECTED);
+
+  // The data is announced by +CIPRXGET: 1 and kept by the module until read
+  uint32_t timerStart = millis();
+  while(!sim800l->isSocketDataAvailable(0) && millis() - timerStart < 1000);
+  uint8_t data[16];
+  int16_t size = sim800l->receiveSocket(0, data, sizeof(data));
+  bool received = size == 5 && memcmp(data, "hello", 5) == 0 && !sim800l->isSocketDataAvailable(0);
+  check(F("receiveSocket() after +CIPRXGET: 1"), received && sim800l->closeSocket(0) && finishScript());
+
+  // MQTT on the same IP context
+  SIM800LMQTT mqtt(sim800l);
+  mockModem.load(STEPS(SCRIPT_MQTT));
+  connected = mqtt.connect(HOST, 1883, "sim800l");
+  bool published = connected && mqtt.publish("sensors/temp", "21.5", 1);
+  mqtt.disconnect();
+  check(F("MQTT connect(), publish() with QoS 1 and disconnect()"), published && !mqtt.isConnected() && finishScript());
+}
+
+void testPool() {
+  // The second module is probed once like any new module
+  SIM800LProbe poolProbe(&poolModem);
+  poolModem.load(STEPS(SCRIPT_PROBE));
+  poolProbe.getModel();
+  finishScript(&poolModem);
+
+  SIM800LPool pool;
+  HTTPRequest queue[1];
+  pool.addModule(sim800l);
+  pool.addModule(&poolProbe);
+  pool.setHTTPQueue(queue, 1);
+  pool.setHTTPQueueCallback(onQueuedRequest);
+  queueSucceeded = 0;
+  queuedBy = NULL;
+  pool.queueGet(URL, NULL, 2000);
+
+  // The request failed by the network on the first module is sent again by the second one
+  mockModem.load(STEPS(SCRIPT_POOL_FAILED));
+  poolModem.load(STEPS(SCRIPT_POOL_RETRY));
+  uint32_t timerStart = millis();
+  while(pool.poll() && millis() - timerStart < 5000);
+  check(F("SIM800LPool failover"), queueSucceeded == 1 && queuedBy == &poolProbe && pool.getQueueLength() == 0 &&
+        !pool.isModuleAvailable(0) && pool.isModuleAvailable(1) && finishScript() && finishScript(&poolModem));
+}
+
+/**
+ * Repeat a request and write its average cost: duration, time spent by the
+ * driver (duration without the latency of the transcript), commands and bytes
+ */
+void benchmark(const __FlashStringHelper* name, bool post) {
+  uint32_t totalUs = 0;
+  uint32_t latencyUs = 0;
+  uint8_t failures = 0;
+  sim800l->resetMetrics();
+
+  for(uint8_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    uint16_t rc;
+    uint32_t timerStart = micros();
+    if(post) {
+      mockModem.load(STEPS(SCRIPT_POST));
+      rc = sim800l->doPost(URL_POST, CONTENT_TYPE, PAYLOAD, 10000, 2000);
+    } else {
+      mockModem.load(STEPS(SCRIPT_GET));
+      rc = sim800l->doGet(URL, 2000);
+    }
+    totalUs += micros() - timerStart;
+    latencyUs += mockModem.getScriptedLatency();
+    if(rc != (post ? 201 : 200) || !finishScript()) {
+      failures++;
+    }
+  }
+
+  const DriverMetrics* metrics = sim800l->getMetrics();
+  uint32_t driverUs = totalUs > latencyUs ? totalUs - latencyUs : 0;
+  Serial.print(F("  "));
+  Serial.print(name);
+  Serial.print(F(" : "));
+  Serial.print(totalUs / BENCHMARK_ITERATIONS);
+  Serial.print(F(" us/request, driver "));
+  Serial.print(driverUs / BENCHMARK_ITERATIONS);
+  Serial.print(F(" us/request, "));
+  Serial.print(metrics->commands / BENCHMARK_ITERATIONS);
+  Serial.print(F(" commands, "));
+  Serial.print(metrics->bytesSent / BENCHMARK_ITERATIONS);
+  Serial.print(F(" bytes sent, "));
+  Serial.print(metrics->bytesReceived / BENCHMARK_ITERATIONS);
+  Serial.print(F(" bytes received, "));
+  Serial.print(failures);
+  Serial.println(F(" failures"));
+}
@@ -30,6 +30,18 @@
  *******************************************************************************/
 #include "SIM800L.h"
 
+/**
+ * Debug messages of a level, the test is constant and the message removed by
+ * the compiler when the level is above SIM800L_LOG_LEVEL
+ */
+#define LOG_ENABLED(level) (SIM800L_LOG_LEVEL >= (level) && enableDebug)
+
+/**
+ * Baud rates supported by the module, from the fastest (in PROGMEM to save memory usage)
+ */
+const uint32_t BAUD_RATES[] PROGMEM = {115200, 57600, 38400, 19200, 9600, 4800, 2400, 1200};
+const uint8_t BAUD_RATES_COUNT = sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]);
+
 /**
  * AT commands required (const char in PROGMEM to save memory usage)
  */
@@ -40,16 +52,26 @@ const char AT_CMD_ATI[] PROGMEM = "ATI";                                      //
 const char AT_CMD_GMR[] PROGMEM = "AT+GMR";                                   // Output version of the firmware
 const char AT_CMD_SIM_CARD[] PROGMEM = "AT+CCID";						      // Get Sim Card version
 
+const char AT_CMD_IPR[] PROGMEM = "AT+IPR=";                                  // Define the baud rate of the serial line
+const char AT_CMD_IFC[] PROGMEM = "AT+IFC=";                                  // Define the flow control of the serial line
+const char AT_CMD_CSCLK0[] PROGMEM = "AT+CSCLK=0";                            // Disable the slow clock
+const char AT_CMD_CSCLK1[] PROGMEM = "AT+CSCLK=1";                            // Enable the slow clock controlled by DTR
+const char AT_CMD_CSCLK2[] PROGMEM = "AT+CSCLK=2";                            // Enable the automatic slow clock
+const char AT_CMD_COMPACT[] PROGMEM = "ATE0V0";                                // Disable the echo and use numeric result codes
+const char AT_CMD_VERBOSE[] PROGMEM = "ATE1V1";                                // Enable the echo and use verbose result codes
+
 const char AT_CMD_CFUN_TEST[] PROGMEM = "AT+CFUN?";                           // Check the current power mode
 const char AT_CMD_CFUN0[] PROGMEM = "AT+CFUN=0";                              // Switch minimum power mode
 const char AT_CMD_CFUN1[] PROGMEM = "AT+CFUN=1";                              // Switch normal power mode
 const char AT_CMD_CFUN4[] PROGMEM = "AT+CFUN=4";                              // Switch sleep power mode
 
 const char AT_CMD_CREG_TEST[] PROGMEM = "AT+CREG?";                           // Check the network registration status
+const char AT_CMD_NETWORK[] PROGMEM = "AT+CREG?;+CSQ;+CGATT?";                // Check registration, signal and GPRS attachment at once
 const char AT_CMD_SAPBR_GPRS[] PROGMEM = "AT+SAPBR=3,1,\"Contype\",\"GPRS\""; // Configure the GPRS bearer
 const char AT_CMD_SAPBR_APN[] PROGMEM = "AT+SAPBR=3,1,\"APN\",";              // Configure the APN for the GPRS
 const char AT_CMD_SAPBR1[] PROGMEM = "AT+SAPBR=1,1";                          // Connect GPRS
 const char AT_CMD_SAPBR0[] PROGMEM = "AT+SAPBR=0,1";                          // Disconnect GPRS
+const char AT_CMD_SAPBR2[] PROGMEM = "AT+SAPBR=2,1";                          // Query the status of the GPRS bearer
 
 const char AT_CMD_HTTPINIT[] PROGMEM = "AT+HTTPINIT";                         // Init HTTP connection
 const char AT_CMD_HTTPPARA_CID[] PROGMEM = "AT+HTTPPARA=\"CID\",1";           // Connect HTTP through GPRS bearer
@@ -58,56 +80,197 @@ const char AT_CMD_HTTPPARA_USERDATA[] PROGMEM = "AT+HTTPPARA=\"USERDATA\",";  //
 const char AT_CMD_HTTPPARA_CONTENT[] PROGMEM = "AT+HTTPPARA=\"CONTENT\",";    // Define the content type for the HTTP POST
 const char AT_CMD_HTTPSSL_Y[] PROGMEM = "AT+HTTPSSL=1";                       // Enable SSL for HTTP connection
 const char AT_CMD_HTTPSSL_N[] PROGMEM = "AT+HTTPSSL=0";                       // Disable SSL for HTTP connection
-const char AT_CMD_HTTPACTION0[] PROGMEM = "AT+HTTPACTION=0";                  // Launch HTTP GET action
-const char AT_CMD_HTTPACTION1[] PROGMEM = "AT+HTTPACTION=1";                  // Launch HTTP POST action
+const char AT_CMD_SSLOPT[] PROGMEM = "AT+SSLOPT=";                            // Define an SSL option
+const char AT_CMD_SSLSETCERT[] PROGMEM = "AT+SSLSETCERT=\"C:\\USER\\";        // Use a certificate of the file system for SSL
+const char AT_CMD_FSCREATE[] PROGMEM = "AT+FSCREATE=C:\\USER\\";              // Create a file in the file system
+const char AT_CMD_FSWRITE[] PROGMEM = "AT+FSWRITE=C:\\USER\\";                // Write a file in the file system
+const char AT_CMD_FSREAD[] PROGMEM = "AT+FSREAD=C:\\USER\\";                  // Read a file of the file system
+const char AT_CMD_FSFLSIZE[] PROGMEM = "AT+FSFLSIZE=C:\\USER\\";              // Get the size of a file of the file system
+const char AT_CMD_FSDEL[] PROGMEM = "AT+FSDEL=C:\\USER\\";                    // Delete a file of the file system
+const char AT_CMD_HTTPACTION[] PROGMEM = "AT+HTTPACTION=";                    // Launch HTTP action (0 GET, 1 POST, 2 HEAD)
+const char HTTP_HEADER_RANGE[] PROGMEM = "Range: bytes=";                     // Header to request the data from an offset
+const char AT_CMD_HTTPHEAD[] PROGMEM = "AT+HTTPHEAD";                         // Read the headers of the HTTP response
+const char AT_CMD_HTTPDATA[] PROGMEM = "AT+HTTPDATA=";                        // Send the data of the HTTP POST
 const char AT_CMD_HTTPREAD[] PROGMEM = "AT+HTTPREAD";                         // Start reading HTTP return data
+const char AT_CMD_HTTPREAD_CHUNK[] PROGMEM = "AT+HTTPREAD=";                  // Start reading a chunk of HTTP return data
 const char AT_CMD_HTTPTERM[] PROGMEM = "AT+HTTPTERM";                         // Terminate HTTP connection
 
+const char AT_CMD_CIPSHUT[] PROGMEM = "AT+CIPSHUT";                           // Close all the sockets and the IP context
+const char AT_CMD_CIPMUX0[] PROGMEM = "AT+CIPMUX=0";                          // Single connection mode
+const char AT_CMD_CIPMUX1[] PROGMEM = "AT+CIPMUX=1";                          // Multi-connection mode
+const char AT_CMD_CIPRXGET1[] PROGMEM = "AT+CIPRXGET=1";                      // Get the data received manually
+const char AT_CMD_CSTT[] PROGMEM = "AT+CSTT=";                                // Define the APN of the IP context
+const char AT_CMD_CIICR[] PROGMEM = "AT+CIICR";                               // Bring up the wireless connection
+const char AT_CMD_CIFSR[] PROGMEM = "AT+CIFSR";                               // Get the local IP address
+const char AT_CMD_CIPSTART[] PROGMEM = "AT+CIPSTART=";                        // Open a TCP/UDP connection
+const char AT_CMD_CIPSEND[] PROGMEM = "AT+CIPSEND=";                          // Send data on a connection
+const char AT_CMD_CIPRXGET2[] PROGMEM = "AT+CIPRXGET=2,";                     // Read data received on a connection
+const char AT_CMD_CIPCLOSE[] PROGMEM = "AT+CIPCLOSE";                         // Close the connection (single connection mode)
+const char AT_CMD_CIPCLOSE_ID[] PROGMEM = "AT+CIPCLOSE=";                     // Close a connection (multi-connection mode)
+
 const char AT_RSP_OK[] PROGMEM = "OK";                                        // Expected answer OK
 const char AT_RSP_DOWNLOAD[] PROGMEM = "DOWNLOAD";                            // Expected answer DOWNLOAD
 const char AT_RSP_HTTPREAD[] PROGMEM = "+HTTPREAD: ";                         // Expected answer HTTPREAD
+const char AT_RSP_HTTPACTION[] PROGMEM = "+HTTPACTION: ";                     // Expected answer HTTPACTION
+const char AT_RSP_HTTPHEAD[] PROGMEM = "+HTTPHEAD: ";                         // Expected answer HTTPHEAD
+const char AT_RSP_ERROR[] PROGMEM = "ERROR";                                  // Error answer
+const char AT_RSP_CM_ERROR[] PROGMEM = "+CME ERROR";                          // Error answer of the equipment (or +CMS ERROR for the SMS)
+const char AT_RSP_OK_CODE[] PROGMEM = "0";                                    // Expected answer OK in compact mode
+const char AT_RSP_ERROR_CODE[] PROGMEM = "4";                                 // Error answer in compact mode
+const char AT_RSP_SAPBR2[] PROGMEM = "+SAPBR: 1,";                            // Expected answer on the status of the GPRS bearer
+const char AT_RSP_SAPBR_DEACT[] PROGMEM = "+SAPBR 1: DEACT";                  // GPRS bearer closed by the network
+const char AT_RSP_PROMPT[] PROGMEM = "> ";                                    // Prompt to send data (without CR/LF)
+const char AT_RSP_FS_PROMPT[] PROGMEM = ">";                                  // Prompt to write a file (without CR/LF)
+const char AT_RSP_FSFLSIZE[] PROGMEM = "+FSFLSIZE: ";                         // Expected answer on the size of a file
+const char AT_RSP_SSLSETCERT[] PROGMEM = "+SSLSETCERT: ";                     // Expected answer on the certificate loaded
+const char AT_RSP_SHUT_OK[] PROGMEM = "SHUT OK";                              // Expected answer SHUT OK
+const char AT_RSP_CIPRXGET1[] PROGMEM = "+CIPRXGET: 1";                       // Data received on a connection
+const char AT_RSP_CIPRXGET2[] PROGMEM = "+CIPRXGET: 2,";                      // Expected answer CIPRXGET on reading
+const char AT_RSP_CONNECT_OK[] PROGMEM = "CONNECT OK";                        // Connection opened
+const char AT_RSP_ALREADY_CONNECT[] PROGMEM = "ALREADY CONNECT";              // Connection already opened
+const char AT_RSP_CONNECT_FAIL[] PROGMEM = "CONNECT FAIL";                    // Connection failed
+const char AT_RSP_CLOSED[] PROGMEM = "CLOSED";                                // Connection closed by the remote
+const char AT_RSP_CLOSE_OK[] PROGMEM = "CLOSE OK";                            // Connection closed
+const char AT_RSP_SEND_OK[] PROGMEM = "SEND OK";                              // Data sent
+const char AT_RSP_SEND_FAIL[] PROGMEM = "SEND FAIL";                          // Data not sent
+const char AT_RSP_PDP_DEACT[] PROGMEM = "+PDP: DEACT";                        // IP context lost by the network
+const char AT_RSP_CFUN[] PROGMEM = "+CFUN: ";                                 // Expected answer on the power mode
+const char AT_RSP_CREG[] PROGMEM = "+CREG: ";                                 // Expected answer on the network registration
+const char AT_RSP_CSQ[] PROGMEM = "+CSQ: ";                                   // Expected answer on the signal strengh
+
+/**
+ * Status queries: command, prefix of the line holding the value (NULL if the
+ * value is the first line which is not the echo) and timeout in millisec
+ * (PROGMEM table, indexed by StatusQueryId)
+ */
+struct StatusQuery {
+  const char* command;
+  const char* answer;
+  uint16_t timeout;
+};
+
+enum StatusQueryId {QUERY_POWER_MODE, QUERY_REGISTRATION, QUERY_SIGNAL, QUERY_VERSION, QUERY_FIRMWARE, QUERY_SIM_CARD};
+
+const StatusQuery STATUS_QUERIES[] PROGMEM = {
+  {AT_CMD_CFUN_TEST, AT_RSP_CFUN, DEFAULT_TIMEOUT},                           // QUERY_POWER_MODE   : +CFUN: <fun>
+  {AT_CMD_CREG_TEST, AT_RSP_CREG, DEFAULT_TIMEOUT},                           // QUERY_REGISTRATION : +CREG: <n>,<stat>
+  {AT_CMD_CSQ,       AT_RSP_CSQ,  DEFAULT_TIMEOUT},                           // QUERY_SIGNAL       : +CSQ: <rssi>,<ber>
+  {AT_CMD_ATI,       NULL,        DEFAULT_TIMEOUT},                           // QUERY_VERSION      : SIM800 R14.18
+  {AT_CMD_GMR,       NULL,        DEFAULT_TIMEOUT},                           // QUERY_FIRMWARE     : Revision:1418B04SIM800L24
+  {AT_CMD_SIM_CARD,  NULL,        DEFAULT_TIMEOUT}                            // QUERY_SIM_CARD     : <ICCID>
+};
+
+/**
+ * Placeholder used when a buffer can't be allocated
+ * (a buffer of 1 byte only holds the final \0, nothing is stored)
+ */
+static char bufferNotAllocated[1];
 
 /**
  * Constructor; Init the driver, communication with the module and shared
  * buffer used by the driver (to avoid multiples allocation)
  */
 SIM800L::SIM800L(Stream* _stream, uint8_t _pinRst, uint16_t _internalBufferSize, uint16_t _recvBufferSize, Stream* _debugStream) {
-  // Store local variables
-  stream = _stream;
-  enableDebug = _debugStream != NULL;
-  debugStream = _debugStream;
-  pinReset = _pinRst;
-
-  if(pinReset != RESET_PIN_NOT_USED) {
-    // Setup the reset pin and force a reset of the module
-    pinMode(pinReset, OUTPUT);
-    reset();
-  }
+  initDriver(_stream, _pinRst, _debugStream);
 
   // Prepare internal buffers
-  if(enableDebug) {
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
     debugStream->print(F("SIM800L : Prepare internal buffer of "));
     debugStream->print(_internalBufferSize);
     debugStream->println(F(" bytes"));
   }
   internalBufferSize = _internalBufferSize;
   internalBuffer = (char*) malloc(internalBufferSize);
+  if(internalBuffer == NULL || internalBufferSize == 0) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : Unable to allocate the internal buffer"));
+    free(internalBuffer);
+    internalBuffer = bufferNotAllocated;
+    internalBufferSize = 1;
+  }
 
-  if(enableDebug) {
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
     debugStream->print(F("SIM800L : Prepare reception buffer of "));
     debugStream->print(_recvBufferSize);
     debugStream->println(F(" bytes"));
   }
   recvBufferSize = _recvBufferSize;
   recvBuffer = (char *) malloc(recvBufferSize);
+  if(recvBuffer == NULL || recvBufferSize == 0) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : Unable to allocate the reception buffer"));
+    free(recvBuffer);
+    recvBuffer = bufferNotAllocated;
+    recvBufferSize = 1;
+  }
+
+  ownBuffers = true;
+}
+
+/**
+ * Constructor; Init the driver and the communication with the module with
+ * buffers provided by the caller (i.e. static buffers, no dynamic allocation)
+ */
+SIM800L::SIM800L(Stream* _stream, uint8_t _pinRst, char* _internalBuffer, uint16_t _internalBufferSize, char* _recvBuffer, uint16_t _recvBufferSize, Stream* _debugStream) {
+  initDriver(_stream, _pinRst, _debugStream);
+
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
+    debugStream->print(F("SIM800L : Use internal buffer of "));
+    debugStream->print(_internalBufferSize);
+    debugStream->print(F(" bytes and reception buffer of "));
+    debugStream->print(_recvBufferSize);
+    debugStream->println(F(" bytes"));
+  }
+
+  internalBuffer = _internalBuffer;
+  internalBufferSize = _internalBufferSize;
+  if(internalBuffer == NULL || internalBufferSize == 0) {
+    internalBuffer = bufferNotAllocated;
+    internalBufferSize = 1;
+  }
+
+  recvBuffer = _recvBuffer;
+  recvBufferSize = _recvBufferSize;
+  if(recvBuffer == NULL || recvBufferSize == 0) {
+    recvBuffer = bufferNotAllocated;
+    recvBufferSize = 1;
+  }
+
+  ownBuffers = false;
 }
 
 /**
  * Destructor; cleanup the memory allocated by the driver
  */
 SIM800L::~SIM800L() {
-  free(internalBuffer);
-  free(recvBuffer);
+  if(ownBuffers) {
+    if(internalBuffer != bufferNotAllocated) {
+      free(internalBuffer);
+    }
+    if(recvBuffer != bufferNotAllocated) {
+      free(recvBuffer);
+    }
+  }
+}
+
+/**
+ * Common initialization of the driver and the communication with the module
+ */
+void SIM800L::initDriver(Stream* _stream, uint8_t _pinRst, Stream* _debugStream) {
+  // Store local variables
+  stream = _stream;
+  enableDebug = _debugStream != NULL;
+  debugStream = _debugStream;
+  pinReset = _pinRst;
+
+  for(uint8_t i = 0; i < SOCKET_MAX_CONNECTIONS; i++) {
+    socketStates[i] = SOCKET_CLOSED;
+  }
+  resetMetrics();
+
+  if(pinReset != (uint8_t)RESET_PIN_NOT_USED) {
+    // Setup the reset pin and force a reset of the module
+    pinMode(pinReset, OUTPUT);
+    reset();
+  }
 }
 
 /**
@@ -119,324 +282,990 @@ uint16_t SIM800L::doPost(const char* url, const char* contentType, const char* p
 
 /**
  * Do HTTP/S POST to a specific URL with headers
+ * Blocking version of beginPost()
  */
 uint16_t SIM800L::doPost(const char* url, const char* headers, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs) {
-  // Cleanup the receive buffer
-  initRecvBuffer();
-  dataSize = 0;
+  if(!beginPost(url, headers, contentType, payload, clientWriteTimeoutMs, serverReadTimeoutMs)) {
+    return 700;
+  }
+  while(poll());
+  return httpResult;
+}
+
+/**
+ * Do HTTP/S GET on a specific URL
+ */
+uint16_t SIM800L::doGet(const char* url, uint16_t serverReadTimeoutMs) {
+  return doGet(url, NULL, serverReadTimeoutMs);
+}
 
-  // Initiate HTTP/S session with the module
-  uint16_t initRC = initiateHTTP(url, headers);
-  if(initRC > 0) {
-    return initRC;
+/**
+ * Do HTTP/S GET on a specific URL with headers
+ * Blocking version of beginGet()
+ */
+uint16_t SIM800L::doGet(const char* url, const char* headers, uint16_t serverReadTimeoutMs) {
+  if(!beginGet(url, headers, serverReadTimeoutMs)) {
+    return 700;
   }
+  while(poll());
+  return httpResult;
+}
 
-  // Define the content type
-  sendCommand_P(AT_CMD_HTTPPARA_CONTENT, contentType);
-  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
-    if(enableDebug) debugStream->println(F("SIM800L : doPost() - Unable to define the content type"));
-    return 7021; //702
+/**
+ * Start an asynchronous HTTP/S POST to a specific URL
+ */
+bool SIM800L::beginPost(const char* url, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs) {
+  return beginPost(url, NULL, contentType, payload, clientWriteTimeoutMs, serverReadTimeoutMs);
+}
+
+/**
+ * Start an asynchronous HTTP/S POST to a specific URL with headers
+ * Return false if another request is ongoing
+ */
+bool SIM800L::beginPost(const char* url, const char* headers, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs) {
+  return startHTTP(HTTP_METHOD_POST, url, headers, contentType, payload, clientWriteTimeoutMs, serverReadTimeoutMs);
+}
+
+/**
+ * Do HTTP/S POST with a payload read from a stream (i.e. a file)
+ * Blocking version of beginPost()
+ */
+uint16_t SIM800L::doPost(const char* url, const char* headers, const char* contentType, Stream* payloadSource, uint32_t payloadSize, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs) {
+  if(!beginPost(url, headers, contentType, payloadSource, payloadSize, clientWriteTimeoutMs, serverReadTimeoutMs)) {
+    return 700;
   }
+  while(poll());
+  return httpResult;
+}
 
-  // Prepare to send the payload
-  char* tmpBuf = (char*)malloc(30);
-  sprintf(tmpBuf, "AT+HTTPDATA=%d,%d", strlen(payload), clientWriteTimeoutMs);
-  sendCommand(tmpBuf);
-  free(tmpBuf);
-  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_DOWNLOAD)) {
-    if(enableDebug) debugStream->println(F("SIM800L : doPost() - Unable to send payload to module"));
-    return 707;
+/**
+ * Do HTTP/S POST with a payload produced by blocks by a callback
+ * Blocking version of beginPost()
+ */
+uint16_t SIM800L::doPost(const char* url, const char* headers, const char* contentType, HTTPPayloadCallback payloadCallback, uint32_t payloadSize, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs) {
+  if(!beginPost(url, headers, contentType, payloadCallback, payloadSize, clientWriteTimeoutMs, serverReadTimeoutMs)) {
+    return 700;
   }
+  while(poll());
+  return httpResult;
+}
 
-  // Write the payload on the module
-  if(enableDebug) {
-    debugStream->print(F("SIM800L : doPost() - Payload to send : "));
-    debugStream->println(payload);
+/**
+ * Start an asynchronous HTTP/S POST with a payload read from a stream
+ * Exactly payloadSize bytes must be available from the stream
+ */
+bool SIM800L::beginPost(const char* url, const char* headers, const char* contentType, Stream* payloadSource, uint32_t payloadSize, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs) {
+  if(!startHTTP(HTTP_METHOD_POST, url, headers, contentType, NULL, clientWriteTimeoutMs, serverReadTimeoutMs)) {
+    return false;
   }
+  httpPayloadSource = payloadSource;
+  httpPayloadSize = payloadSize;
+  return true;
+}
 
-  purgeSerial();
-  stream->write(payload);
-  stream->flush();
-  delay(500);
+/**
+ * Start an asynchronous HTTP/S POST with a payload produced by a callback
+ * The callback must produce exactly payloadSize bytes in total
+ */
+bool SIM800L::beginPost(const char* url, const char* headers, const char* contentType, HTTPPayloadCallback payloadCallback, uint32_t payloadSize, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs) {
+  if(!startHTTP(HTTP_METHOD_POST, url, headers, contentType, NULL, clientWriteTimeoutMs, serverReadTimeoutMs)) {
+    return false;
+  }
+  httpPayloadCallback = payloadCallback;
+  httpPayloadSize = payloadSize;
+  return true;
+}
 
-  // Start HTTP POST action
-  sendCommand_P(AT_CMD_HTTPACTION1);
-  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
-    if(enableDebug) debugStream->println(F("SIM800L : doPost() - Unable to initiate POST action"));
-    return 703;
+/**
+ * Start an asynchronous HTTP/S GET on a specific URL
+ */
+bool SIM800L::beginGet(const char* url, uint16_t serverReadTimeoutMs) {
+  return beginGet(url, NULL, serverReadTimeoutMs);
+}
+
+/**
+ * Start an asynchronous HTTP/S GET on a specific URL with headers
+ * Return false if another request is ongoing
+ */
+bool SIM800L::beginGet(const char* url, const char* headers, uint16_t serverReadTimeoutMs) {
+  return startHTTP(HTTP_METHOD_GET, url, headers, NULL, NULL, 0, serverReadTimeoutMs);
+}
+
+/**
+ * Do HTTP/S HEAD on a specific URL with headers (no data received, only the
+ * status, the size and the headers of the response)
+ * Blocking version of beginHead()
+ */
+uint16_t SIM800L::doHead(const char* url, const char* headers, uint16_t serverReadTimeoutMs) {
+  if(!beginHead(url, headers, serverReadTimeoutMs)) {
+    return 700;
   }
+  while(poll());
+  return httpResult;
+}
+
+/**
+ * Start an asynchronous HTTP/S HEAD on a specific URL with headers
+ * Return false if another request is ongoing
+ */
+bool SIM800L::beginHead(const char* url, const char* headers, uint16_t serverReadTimeoutMs) {
+  return startHTTP(HTTP_METHOD_HEAD, url, headers, NULL, NULL, 0, serverReadTimeoutMs);
+}
 
-  // Wait answer from the server
-  if(!readResponse(serverReadTimeoutMs)) {
-    if(enableDebug) debugStream->println(F("SIM800L : doPost() - Server timeout"));
-    return 408;
+/**
+ * Register the request and reset the state machine on the first step
+ */
+bool SIM800L::startHTTP(uint8_t method, const char* url, const char* headers, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs) {
+  if(httpState != HTTP_IDLE && httpState != HTTP_DONE) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : startHTTP() - Another HTTP request is ongoing"));
+    return false;
   }
 
-  // Extract status information
-  int16_t idxBase = strIndex(internalBuffer, "+HTTPACTION: 1,");
-  if(idxBase < 0) {
-    if(enableDebug) debugStream->println(F("SIM800L : doPost() - Invalid answer on HTTP POST"));
-    return 703;
+  httpMethod = method;
+  httpUrl = url;
+  httpHeaders = headers;
+  httpContentType = contentType;
+  httpPayload = payload;
+  httpPayloadSize = payload != NULL ? strlen(payload) : 0;
+  httpPayloadSource = NULL;
+  httpPayloadCallback = NULL;
+  httpWriteTimeoutMs = clientWriteTimeoutMs;
+  httpReadTimeoutMs = serverReadTimeoutMs;
+  httpResult = 0;
+  httpFailed = false;
+  httpDataLength = 0;
+  httpReadOffset = 0;
+  httpDownload = false;
+  httpRangeStart = 0;
+  if(httpHeadersBuffer != NULL) {
+    httpHeadersBuffer[0] = '\0';
   }
 
-  // Get the HTTP return code
-  uint16_t httpRC = 0;
-  httpRC += (internalBuffer[idxBase + 15] - '0') * 100;
-  httpRC += (internalBuffer[idxBase + 16] - '0') * 10;
-  httpRC += (internalBuffer[idxBase + 17] - '0') * 1;
+  // Cleanup the receive buffer
+  initRecvBuffer();
+  dataSize = 0;
 
-  if(enableDebug) {
-    debugStream->print(F("SIM800L : doPost() - HTTP status "));
-    debugStream->println(httpRC);
-  }
+  httpState = HTTP_INIT;
+  return true;
+}
+
+/**
+ * Execute the next step of the HTTP request
+ * Each step is a short exchange with the module, except the wait of the server
+ * answer which is checked without blocking until the timeout
+ * Return true while the request is not finished
+ */
+bool SIM800L::poll() {
+  // Write the debug messages queued since the last call
+  flushLog();
+
+  // Dispatch the unsolicited messages received since the last call
+  processURC();
+
+  // Let the module sleep if nothing is going on
+  sleepIfIdle();
+
+  switch(httpState) {
+    case HTTP_INIT: {
+      // Check the bearer first (connected again only if needed)
+      if(autoConnectGPRS && !ensureGPRS()) {
+        if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : poll() - GPRS bearer not connected"));
+        httpResult = 709;
+        httpFailed = true;
+        httpState = HTTP_DONE;
+        break;
+      }
 
-  if(httpRC == 200) {
-    // Get the size of the data to receive
-    dataSize = 0;
-    for(uint16_t i = 0; (internalBuffer[idxBase + 19 + i] - '0') >= 0 && (internalBuffer[idxBase + 19 + i] - '0') <= 9; i++) {
-      if(i != 0) {
-        dataSize = dataSize * 10;
+      // Initiate HTTP/S session with the module
+      uint32_t timerStart = millis();
+      uint16_t initRC = initiateHTTP(httpUrl, httpHeaders);
+      if(initRC > 0) {
+        httpResult = initRC;
+        httpFailed = true;
+        // Don't keep a partially initiated session on the module
+        if(httpSessionOpen) {
+          terminateHTTP();
+        }
+        httpState = HTTP_DONE;
+        break;
       }
-      dataSize += (internalBuffer[idxBase + 19 + i] - '0');
+      recordPhase(METRICS_HTTP_INIT, timerStart);
+      httpState = httpMethod == HTTP_METHOD_POST ? HTTP_CONTENT_TYPE : HTTP_ACTION;
+      break;
     }
 
-    if(enableDebug) {
-      debugStream->print(F("SIM800L : doPost() - Data size received of "));
-      debugStream->print(dataSize);
-      debugStream->println(F(" bytes"));
+    case HTTP_CONTENT_TYPE: {
+      // Define the content type (if not already defined in the session)
+      if(!httpContentTypeKept || strcmp(httpContentType, httpContentTypeCopy) != 0) {
+        sendCommand_P(AT_CMD_HTTPPARA_CONTENT, httpContentType);
+        if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+          if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : poll() - Unable to define the content type"));
+          failHTTP(7021); //702
+          break;
+        }
+        httpContentTypeKept = keepCopy(httpContentTypeCopy, sizeof(httpContentTypeCopy), httpContentType);
+      }
+      httpState = HTTP_UPLOAD;
+      break;
     }
 
-    // Ask for reading and detect the start of the reading...
-    sendCommand_P(AT_CMD_HTTPREAD);
-    if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_HTTPREAD, 2)) {
-      return 705;
+    case HTTP_UPLOAD: {
+      uint32_t timerStart = millis();
+      uint16_t uploadRC = uploadHTTPData();
+      if(uploadRC > 0) {
+        failHTTP(uploadRC);
+        break;
+      }
+      recordPhase(METRICS_HTTP_UPLOAD, timerStart);
+      httpState = HTTP_ACTION;
+      break;
     }
 
-    // Read number of bytes defined in the dataSize
-    for(uint16_t i = 0; i < dataSize && i < recvBufferSize; i++) {
-      while(!stream->available());
-      if(stream->available()) {
-        // Load the next char
-        recvBuffer[i] = stream->read();
-        // If the character is CR or LF, ignore it (it's probably part of the module communication schema)
-        if((recvBuffer[i] == '\r') || (recvBuffer[i] == '\n')) {
-          i--;
+    case HTTP_ACTION:
+      // Start HTTP GET, POST or HEAD action
+      sendCommand_P(AT_CMD_HTTPACTION, (uint32_t)httpMethod);
+      if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+        if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : poll() - Unable to initiate HTTP action"));
+        failHTTP(703);
+        break;
+      }
+
+      // The answer comes after the OK, a +HTTPACTION received until now is
+      // a late answer of a previous request (i.e. after a server timeout)
+      httpActionReceived = false;
+
+      // Prepare to wait the answer from the server (+HTTPACTION URC)
+      httpTimerStart = millis();
+      httpState = HTTP_WAIT_RESPONSE;
+      break;
+
+    case HTTP_WAIT_RESPONSE: {
+      // Wait answer from the server without blocking (the longest wait of the
+      // request, the idle hook is called as while waiting for the module)
+      if(httpActionReceived && httpActionMethod != httpMethod) {
+        // Late answer of a previous request of another method
+        httpActionReceived = false;
+      }
+      if(!httpActionReceived) {
+        if(millis() - httpTimerStart > httpReadTimeoutMs) {
+          if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : poll() - Server timeout"));
+          failHTTP(408);
+        } else if(idleHook != NULL) {
+          idleHook(this);
         }
+        break;
+      }
+
+      recordPhase(METRICS_HTTP_ACTION, httpTimerStart);
+      uint16_t httpRC = parseHTTPAction();
+      if(httpRC < 100) {
+        failHTTP(703);
+        break;
+      }
+      httpResult = httpRC;
+      httpPhaseStart = millis();
+
+      // The headers are read for all the answers of the server (not for the errors of the module, 6xx)
+      if(httpHeadersBuffer != NULL && httpRC < 600) {
+        httpState = HTTP_HEADERS;
+      } else {
+        httpState = hasHTTPData() ? HTTP_READ : HTTP_TERM;
       }
+      break;
     }
 
-    if(recvBufferSize < dataSize) {
-      dataSize = recvBufferSize;
-      if(enableDebug) {
-        debugStream->println(F("SIM800L : doPost() - Buffer overflow while loading data from HTTP. Keep only first bytes..."));
+    case HTTP_HEADERS: {
+      uint16_t headersRC = readHTTPHeaders();
+      if(headersRC > 0) {
+        failHTTP(headersRC);
+        break;
       }
+      httpState = hasHTTPData() ? HTTP_READ : HTTP_TERM;
+      break;
     }
 
-    // We are expecting a final OK
-    if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
-      if(enableDebug) debugStream->println(F("SIM800L : doPost() - Invalid end of data while reading HTTP result from the module"));
-      return 705;
+    case HTTP_READ: {
+      // In streaming mode, one chunk is read at each step
+      bool streaming = httpDataSink != NULL || httpDataCallback != NULL;
+      uint16_t readRC = streaming ? readHTTPChunk() : readHTTPData();
+      if(readRC > 0) {
+        failHTTP(readRC);
+        break;
+      }
+      if(!streaming || httpReadOffset >= httpDataLength) {
+        recordPhase(METRICS_HTTP_READ, httpPhaseStart);
+        httpState = HTTP_TERM;
+      }
+      break;
     }
 
-    if(enableDebug) {
-      debugStream->print(F("SIM800L : doPost() - Received from HTTP POST : "));
-      debugStream->println(recvBuffer);
+    case HTTP_TERM: {
+      // Terminate HTTP/S session (except if the session is kept for the next request)
+      if(!httpKeepSession || httpFailed) {
+        uint16_t termRC = terminateHTTP();
+        if(termRC > 0 && !httpFailed) {
+          httpResult = termRC;
+        }
+      }
+      httpState = HTTP_DONE;
+      break;
     }
-  }
 
-  // Terminate HTTP/S session
-  uint16_t termRC = terminateHTTP();
-  if(termRC > 0) {
-    return termRC;
+    default:
+      return false;
   }
 
-  return httpRC;
-}
-
-/**
- * Do HTTP/S GET on a specific URL
- */
-uint16_t SIM800L::doGet(const char* url, uint16_t serverReadTimeoutMs) {
-  return doGet(url, NULL, serverReadTimeoutMs);
+  // Notify the end of the request
+  if(httpState == HTTP_DONE) {
+    metrics.httpRequests++;
+    if(httpFailed) {
+      metrics.httpFailures++;
+    }
+    if(httpCallback != NULL) {
+      httpCallback(this, httpResult);
+    }
+    if(httpQueueDraining) {
+      return nextQueuedHTTP();
+    }
+    return false;
+  }
+  return true;
 }
 
 /**
- * Do HTTP/S GET on a specific URL with headers
+ * Send the payload of the POST to the module (AT+HTTPDATA)
+ * The payload is written at once or pulled by blocks from the source or the
+ * producer callback, then the module confirms the reception with OK
+ * Return 0 if successful or the error code
  */
-uint16_t SIM800L::doGet(const char* url, const char* headers, uint16_t serverReadTimeoutMs) {
-  // Cleanup the receive buffer
-  initRecvBuffer();
-  dataSize = 0;
-
-  // Initiate HTTP/S session
-  uint16_t initRC = initiateHTTP(url, headers);
-  if(initRC > 0) {
-    return initRC;
-  }
-
-  // Start HTTP GET action
-  sendCommand_P(AT_CMD_HTTPACTION0);
-  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
-    if(enableDebug) debugStream->println(F("SIM800L : doGet() - Unable to initiate GET action"));
-    return 703;
-  }
-
-  // Wait answer from the server
-  if(!readResponse(serverReadTimeoutMs)) {
-    if(enableDebug) debugStream->println(F("SIM800L : doGet() - Server timeout"));
-    return 408;
-  }
-
-  // Extract status information
-  int16_t idxBase = strIndex(internalBuffer, "+HTTPACTION: 0,");
-  if(idxBase < 0) {
-    if(enableDebug) debugStream->println(F("SIM800L : doGet() - Invalid answer on HTTP GET"));
-    return 703;
-  }
-
-  // Get the HTTP return code
-  uint16_t httpRC = 0;
-  httpRC += (internalBuffer[idxBase + 15] - '0') * 100;
-  httpRC += (internalBuffer[idxBase + 16] - '0') * 10;
-  httpRC += (internalBuffer[idxBase + 17] - '0') * 1;
-
-  if(enableDebug) {
-    debugStream->print(F("SIM800L : doGet() - HTTP status "));
-    debugStream->println(httpRC);
+uint16_t SIM800L::uploadHTTPData() {
+  // Prepare to send the payload
+  sendCommand_P(AT_CMD_HTTPDATA, httpPayloadSize, httpWriteTimeoutMs);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_DOWNLOAD)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : uploadHTTPData() - Unable to send payload to module"));
+    return 707;
   }
 
-  if(httpRC == 200) {
-    // Get the size of the data to receive
-    dataSize = 0;
-    for(uint16_t i = 0; (internalBuffer[idxBase + 19 + i] - '0') >= 0 && (internalBuffer[idxBase + 19 + i] - '0') <= 9; i++) {
-      if(i != 0) {
-        dataSize = dataSize * 10;
-      }
-      dataSize += (internalBuffer[idxBase + 19 + i] - '0');
-    }
+  purgeSerial();
 
-    if(enableDebug) {
-      debugStream->print(F("SIM800L : doGet() - Data size received of "));
-      debugStream->print(dataSize);
-      debugStream->println(F(" bytes"));
+  if(httpPayload != NULL) {
+    // Write the payload on the module
+    if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
+      debugStream->print(F("SIM800L : uploadHTTPData() - Payload to send : "));
+      debugStream->println(httpPayload);
     }
-
-    // Ask for reading and detect the start of the reading...
-    sendCommand_P(AT_CMD_HTTPREAD);
-    if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_HTTPREAD, 2)) {
-      return 705;
+    if(!writeToModule((const uint8_t*)httpPayload, httpPayloadSize)) {
+      if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : uploadHTTPData() - Module not clear to send"));
+      return 707;
     }
+  } else {
+    // Write the payload by blocks (the reception buffer is not used while uploading)
+    uint32_t offset = 0;
+    while(offset < httpPayloadSize) {
+      uint16_t blockSize = recvBufferSize;
+      if(httpPayloadSize - offset < blockSize) {
+        blockSize = httpPayloadSize - offset;
+      }
 
-    // Read number of bytes defined in the dataSize
-    for(uint16_t i = 0; i < dataSize && i < recvBufferSize; i++) {
-      while(!stream->available());
-      if(stream->available()) {
-        // Load the next char
-        recvBuffer[i] = stream->read();
-        // If the character is CR or LF, ignore it (it's probably part of the module communication schema)
-        if((recvBuffer[i] == '\r') || (recvBuffer[i] == '\n')) {
-          i--;
-        }
+      uint16_t size;
+      if(httpPayloadSource != NULL) {
+        size = httpPayloadSource->readBytes(recvBuffer, blockSize);
+      } else {
+        size = httpPayloadCallback(this, recvBuffer, blockSize, offset);
+      }
+      if(size == 0 || size > blockSize) {
+        if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : uploadHTTPData() - Payload source exhausted before the announced size"));
+        return 707;
       }
-    }
 
-    if(recvBufferSize < dataSize) {
-      dataSize = recvBufferSize;
-      if(enableDebug) {
-        debugStream->println(F("SIM800L : doGet() - Buffer overflow while loading data from HTTP. Keep only first bytes..."));
+      if(!writeToModule((const uint8_t*)recvBuffer, size)) {
+        if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : uploadHTTPData() - Module not clear to send"));
+        return 707;
       }
+      offset += size;
     }
 
-    // We are expecting a final OK
-    if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
-      if(enableDebug) debugStream->println(F("SIM800L : doGet() - Invalid end of data while reading HTTP result from the module"));
-      return 705;
+    if(LOG_ENABLED(SIM800L_LOG_INFO)) {
+      debugStream->print(F("SIM800L : uploadHTTPData() - Payload sent of "));
+      debugStream->print(offset);
+      debugStream->println(F(" bytes"));
     }
+  }
+  stream->flush();
 
-    if(enableDebug) {
-      debugStream->print(F("SIM800L : doGet() - Received from HTTP GET : "));
-      debugStream->println(recvBuffer);
-    }
+  // The module answers OK when all the bytes are received
+  if(!readResponseCheckAnswer_P(httpWriteTimeoutMs > DEFAULT_TIMEOUT ? httpWriteTimeoutMs : DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : uploadHTTPData() - Payload not confirmed by the module"));
+    return 707;
   }
 
-  // Terminate HTTP/S session
-  uint16_t termRC = terminateHTTP();
-  if(termRC > 0) {
-    return termRC;
+  // Cleanup the reception buffer used by the blocks
+  if(httpPayload == NULL) {
+    initRecvBuffer();
   }
+  return 0;
+}
 
-  return httpRC;
+/**
+ * Abort the HTTP request after an error but keep the module clean by
+ * terminating the HTTP session (the error code is kept as the result)
+ */
+void SIM800L::failHTTP(uint16_t errorRC) {
+  httpResult = errorRC;
+  httpFailed = true;
+  httpState = HTTP_TERM;
 }
 
 /**
- * Meta method to initiate the HTTP/S session on the module
+ * Extract the HTTP status code and the size of the data from the answer
+ * of the server (+HTTPACTION: <method>,<status>,<size>)
+ * Return 0 if the answer is invalid
  */
-uint16_t SIM800L::initiateHTTP(const char* url, const char* headers) {
-  // Init HTTP connection
-  sendCommand_P(AT_CMD_HTTPINIT);
-  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
-    if(enableDebug) debugStream->println(F("SIM800L : initiateHTTP() - Unable to init HTTP"));
-    return 701;
+uint16_t SIM800L::parseHTTPAction() {
+  if(httpActionMethod != httpMethod) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : parseHTTPAction() - Invalid answer on HTTP action"));
+    return 0;
   }
 
-  // Use the GPRS bearer
-  sendCommand_P(AT_CMD_HTTPPARA_CID);
-  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
-    if(enableDebug) debugStream->println(F("SIM800L : initiateHTTP() - Unable to define bearer"));
-    return 7022;  //702
-  }
+  // Get the HTTP return code
+  uint16_t httpRC = httpActionStatus;
 
-  // Define URL to look for
-  sendCommand_P(AT_CMD_HTTPPARA_URL, url);
-  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
-    if(enableDebug) debugStream->println(F("SIM800L : initiateHTTP() - Unable to define the URL"));
-    return 7023;  //702
+  if(LOG_ENABLED(SIM800L_LOG_INFO)) {
+    debugStream->print(F("SIM800L : parseHTTPAction() - HTTP status "));
+    debugStream->println(httpRC);
   }
 
-  // Set Headers
-  if (headers != NULL) {
-    sendCommand_P(AT_CMD_HTTPPARA_USERDATA, headers);
-    if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
-      if(enableDebug) debugStream->println(F("SIM800L : initiateHTTP() - Unable to define Headers"));
-      return 7024; //702
+  // Get the size of the data announced by the server (whatever the status)
+  httpDataLength = httpActionSize;
+
+  // On a download, the response starts at the offset requested (206) or at
+  // the start of the resource if the server ignores the range (200), then the
+  // bytes already received are skipped on the module
+  if(httpDownload) {
+    if(httpRC == 206) {
+      httpRangeStart = httpDownloadOffset;
+    } else if(httpRC == 200) {
+      httpReadOffset = httpDownloadOffset;
     }
   }
-
-  // Check if the firmware support HTTPSSL command
-  bool isSupportSSL = false;
-  char* version = getVersion();
-  int16_t rIdx = strIndex(version, "R");
-  if(rIdx > 0) {
-    uint8_t releaseInt = (version[rIdx + 1] - '0') * 10 + (version[rIdx + 2] - '0');
-
-    // The release should be greater or equals to 14 to support SSL stack
-    if(releaseInt >= 14) {
-      isSupportSSL = true;
-      if(enableDebug) debugStream->println(F("SIM800L : initiateHTTP() - Support of SSL enabled"));
-    } else {
-      isSupportSSL = false;
-      if(enableDebug) debugStream->println(F("SIM800L : initiateHTTP() - Support of SSL disabled (SIM800L firware below R14)"));
-    }
+  if(hasHTTPData()) {
+    dataSize = httpDataLength > 0xFFFF ? 0xFFFF : httpDataLength;
+  }
+
+  if(LOG_ENABLED(SIM800L_LOG_INFO)) {
+    debugStream->print(F("SIM800L : parseHTTPAction() - Data size received of "));
+    debugStream->print(httpDataLength);
+    debugStream->println(F(" bytes"));
+  }
+
+  return httpRC;
+}
+
+/**
+ * Check if the data of the response has to be read: successful status
+ * (2xx, i.e. 200, 201 or 206) with data, except for HEAD
+ */
+bool SIM800L::hasHTTPData() {
+  return httpMethod != HTTP_METHOD_HEAD && httpActionStatus >= 200 && httpActionStatus < 300 && httpDataLength > 0;
+}
+
+/**
+ * Read the headers of the response (AT+HTTPHEAD) into the headers buffer,
+ * one line terminated by \0 per header (the status line and the overflow
+ * are dropped)
+ * Return 0 if successful or the error code
+ */
+uint16_t SIM800L::readHTTPHeaders() {
+  sendCommand_P(AT_CMD_HTTPHEAD);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_HTTPHEAD)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : readHTTPHeaders() - Unable to read the headers"));
+    return 710;
+  }
+
+  // Template : +HTTPHEAD: <size> then the headers separated by CR/LF
+  int16_t idx = strIndex(internalBuffer, "+HTTPHEAD: ");
+  uint16_t size = idx >= 0 ? atoi(internalBuffer + idx + 11) : 0;
+  uint16_t length = 0;
+  uint16_t lineStart = 0;
+  bool truncated = false;
+  uint32_t timerStart = millis();
+  for(uint32_t i = 0; i <= size; i++) {
+    // The last line may not be terminated by LF
+    char c = '\n';
+    if(i < size) {
+      if(!waitData(timerStart, DEFAULT_TIMEOUT)) {
+        if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : readHTTPHeaders() - Timeout while reading the headers"));
+        return 708;
+      }
+      c = readFromModule();
+      timerStart = millis();
+    }
+
+    if(c == '\n') {
+      // Drop the lines which don't fit and the status line (i.e. HTTP/1.1 200 OK), skip the empty lines
+      if(truncated || (length - lineStart >= 5 && strncmp(httpHeadersBuffer + lineStart, "HTTP/", 5) == 0)) {
+        length = lineStart;
+        truncated = false;
+      } else if(length > lineStart) {
+        httpHeadersBuffer[length++] = '\0';
+      }
+      lineStart = length;
+    } else if(c != '\r' && !truncated) {
+      // Keep two bytes for the end of the line and the final empty line
+      if(length >= httpHeadersSize - 2) {
+        truncated = true;
+      } else {
+        httpHeadersBuffer[length++] = c;
+      }
+    }
+  }
+  httpHeadersBuffer[length] = '\0';
+
+  // We are expecting a final OK
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : readHTTPHeaders() - Invalid end of the headers"));
+    return 710;
+  }
+  return 0;
+}
+
+/**
+ * Define the buffer receiving the headers of the HTTP responses (NULL to
+ * not read the headers); the status line and the headers which don't fit
+ * in the buffer are dropped
+ */
+void SIM800L::setHTTPHeadersBuffer(char* buffer, uint16_t size) {
+  if(buffer != NULL && size < 3) {
+    buffer = NULL;
+  }
+  httpHeadersBuffer = buffer;
+  httpHeadersSize = buffer != NULL ? size : 0;
+  if(httpHeadersBuffer != NULL) {
+    httpHeadersBuffer[0] = '\0';
+  }
+}
+
+/**
+ * Return the value of a header of the last HTTP response (the name is not
+ * case sensitive, i.e. "ETag" or "Last-Modified"), NULL if not received
+ */
+const char* SIM800L::getHTTPHeader(const char* name) {
+  if(httpHeadersBuffer == NULL) {
+    return NULL;
+  }
+  uint8_t nameSize = strlen(name);
+  for(const char* line = httpHeadersBuffer; *line != '\0'; line += strlen(line) + 1) {
+    if(strncasecmp(line, name, nameSize) == 0 && line[nameSize] == ':') {
+      const char* value = line + nameSize + 1;
+      while(*value == ' ') {
+        value++;
+      }
+      return value;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Read the data returned by the server into the reception buffer
+ * Return 0 if successful or the error code
+ */
+uint16_t SIM800L::readHTTPData() {
+  // Ask for reading and detect the start of the reading...
+  sendCommand_P(AT_CMD_HTTPREAD);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_HTTPREAD)) {
+    return 705;
+  }
+
+  if(binaryMode) {
+    // Read exactly the number of bytes announced by the module
+    uint16_t size = parseHTTPReadSize();
+    uint16_t sizeKept = size < recvBufferSize ? size : recvBufferSize;
+    if(!readRawData(recvBuffer, sizeKept) || !readRawData(NULL, size - sizeKept)) {
+      if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : readHTTPData() - Timeout while loading data from HTTP"));
+      return 708;
+    }
+    dataSize = sizeKept;
+    if(dataSize < recvBufferSize) {
+      recvBuffer[dataSize] = '\0';
+    }
+    if(sizeKept < size && LOG_ENABLED(SIM800L_LOG_ERROR)) {
+      debugStream->println(F("SIM800L : readHTTPData() - Buffer overflow while loading data from HTTP. Keep only first bytes..."));
+    }
+  } else {
+    // Read number of bytes defined in the dataSize (the timeout is restarted on each byte)
+    // keeping the last byte of the buffer for the final \0
+    uint16_t sizeKept = dataSize < recvBufferSize ? dataSize : recvBufferSize - 1;
+    uint32_t timerStart = millis();
+    for(uint16_t i = 0; i < sizeKept; i++) {
+      if(!waitData(timerStart, DEFAULT_TIMEOUT)) {
+        if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : readHTTPData() - Timeout while loading data from HTTP"));
+        return 708;
+      }
+      // Load the next char
+      recvBuffer[i] = readFromModule();
+      timerStart = millis();
+      // If the character is CR or LF, ignore it (it's probably part of the module communication schema)
+      if((recvBuffer[i] == '\r') || (recvBuffer[i] == '\n')) {
+        i--;
+      }
+    }
+
+    if(sizeKept < dataSize) {
+      dataSize = sizeKept;
+      if(LOG_ENABLED(SIM800L_LOG_ERROR)) {
+        debugStream->println(F("SIM800L : readHTTPData() - Buffer overflow while loading data from HTTP. Keep only first bytes..."));
+      }
+    }
+    recvBuffer[dataSize] = '\0';
+  }
+
+  // We are expecting a final OK
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : readHTTPData() - Invalid end of data while reading HTTP result from the module"));
+    return 705;
+  }
+
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG) && !binaryMode) {
+    debugStream->print(F("SIM800L : readHTTPData() - Received from HTTP : "));
+    debugStream->println(recvBuffer);
+  }
+
+  return 0;
+}
+
+/**
+ * Read the next chunk of the data returned by the server (AT+HTTPREAD=<start>,<size>)
+ * and give it to the sink and/or the callback; the reception buffer is used
+ * to hold the chunk
+ * Return 0 if successful or the error code
+ */
+uint16_t SIM800L::readHTTPChunk() {
+  if(httpReadOffset >= httpDataLength) {
+    return 0;
+  }
+
+  // The chunk is limited by the reception buffer (keep one byte for the final \0)
+  if(recvBufferSize < 2) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : readHTTPChunk() - Reception buffer not allocated"));
+    return 705;
+  }
+  uint16_t chunkSize = recvBufferSize - 1;
+  if(httpDataLength - httpReadOffset < chunkSize) {
+    chunkSize = httpDataLength - httpReadOffset;
+  }
+
+  // Ask for reading the chunk and detect the start of the reading...
+  sendCommand_P(AT_CMD_HTTPREAD_CHUNK, httpReadOffset, chunkSize);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_HTTPREAD)) {
+    return 705;
+  }
+
+  // Get the size of the chunk really sent by the module
+  uint16_t size = parseHTTPReadSize();
+  if(size == 0 || size > chunkSize) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : readHTTPChunk() - Invalid size of chunk"));
+    return 705;
+  }
+
+  // Read exactly the size of the chunk (including CR and LF)
+  if(!readRawData(recvBuffer, size)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : readHTTPChunk() - Timeout while reading the chunk"));
+    return 708;
+  }
+  recvBuffer[size] = '\0';
+  dataSize = size;
+
+  // We are expecting a final OK
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : readHTTPChunk() - Invalid end of data while reading HTTP result from the module"));
+    return 705;
+  }
+
+  // Give the chunk to the user
+  if(httpDataSink != NULL) {
+    httpDataSink->write((const uint8_t*)recvBuffer, size);
+  }
+  if(httpDataCallback != NULL) {
+    httpDataCallback(this, recvBuffer, size, httpRangeStart + httpReadOffset);
+  }
+  httpReadOffset += size;
+  if(httpDownload) {
+    httpDownloadOffset = httpRangeStart + httpReadOffset;
+  }
+
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
+    debugStream->print(F("SIM800L : readHTTPChunk() - Received "));
+    debugStream->print(httpReadOffset);
+    debugStream->print(F("/"));
+    debugStream->println(httpDataLength);
+  }
+
+  return 0;
+}
+
+/**
+ * Start the request at the head of the queue
+ */
+bool SIM800L::startQueuedHTTP() {
+  HTTPRequest* request = &httpQueue[httpQueueHead];
+  return startHTTP(request->contentType != NULL ? HTTP_METHOD_POST : HTTP_METHOD_GET, request->url, request->headers, request->contentType, request->payload, request->clientWriteTimeoutMs, request->serverReadTimeoutMs);
+}
+
+/**
+ * Report the result of the request at the head of the queue, remove it and
+ * start the next one; the session is closed after the last request (except
+ * with the persistent session mode)
+ * Return true while the queue is not empty
+ */
+bool SIM800L::nextQueuedHTTP() {
+  HTTPRequest* request = &httpQueue[httpQueueHead];
+  if(httpQueueCallback != NULL) {
+    httpQueueCallback(this, request, httpResult);
+  }
+  if(httpResult >= 200 && httpResult < 300) {
+    httpQueueSucceeded++;
+  }
+  httpQueueHead = (httpQueueHead + 1) % httpQueueSize;
+  httpQueueCount--;
+
+  if(httpQueueCount > 0 && startQueuedHTTP()) {
+    return true;
+  }
+
+  httpQueueDraining = false;
+  httpKeepSession = httpQueueKeepSession;
+  if(!httpKeepSession && httpSessionOpen) {
+    terminateHTTP();
+  }
+  return false;
+}
+
+/**
+ * Extract the number of bytes announced by the module before the data (+HTTPREAD: <size>)
+ */
+uint16_t SIM800L::parseHTTPReadSize() {
+  int16_t idx = strIndex(internalBuffer, "+HTTPREAD: ");
+  uint16_t size = 0;
+  if(idx >= 0) {
+    for(uint16_t i = idx + 11; internalBuffer[i] >= '0' && internalBuffer[i] <= '9'; i++) {
+      size = size * 10 + (internalBuffer[i] - '0');
+    }
+  }
+  return size;
+}
+
+/**
+ * Keep the data received in the reception buffer as is (no CR/LF filtering)
+ * and trust the size announced by the module
+ */
+void SIM800L::setBinaryMode(bool enable) {
+  binaryMode = enable;
+}
+
+/**
+ * Define the sink receiving the data of the HTTP requests by chunks
+ * (NULL to go back to the reception buffer)
+ */
+void SIM800L::setHTTPDataSink(Print* sink) {
+  httpDataSink = sink;
+}
+
+/**
+ * Define the callback receiving the data of the HTTP requests by chunks
+ * (NULL to go back to the reception buffer)
+ */
+void SIM800L::setHTTPDataCallback(HTTPDataCallback callback) {
+  httpDataCallback = callback;
+}
+
+/**
+ * Return the size of the data announced by the server for the last HTTP request
+ */
+uint32_t SIM800L::getContentLength() {
+  return httpDataLength;
+}
+
+/**
+ * Do a resumable HTTP/S GET from an offset of the resource to the sink and/or
+ * the callback of the data; after a failure of the transfer (network, stall,
+ * timeout...), the download is resumed from the last byte received, up to
+ * maxAttempts requests. The answers of the server (i.e. 404) are not retried
+ * Blocking version of beginDownload()
+ */
+uint16_t SIM800L::doDownload(const char* url, uint32_t offset, uint16_t serverReadTimeoutMs, uint8_t maxAttempts) {
+  for(uint8_t attempt = 0; attempt < maxAttempts; attempt++) {
+    if(attempt > 0) {
+      metrics.retries++;
+      if(LOG_ENABLED(SIM800L_LOG_INFO)) {
+        debugStream->print(F("SIM800L : doDownload() - Resume the download at "));
+        debugStream->println(httpDownloadOffset);
+      }
+      // The bearer may have been lost during the transfer
+      if(!ensureGPRS()) {
+        httpResult = 709;
+        continue;
+      }
+    }
+
+    if(!beginDownload(url, attempt > 0 ? httpDownloadOffset : offset, serverReadTimeoutMs)) {
+      return 700;
+    }
+    while(poll());
+
+    if(httpResult >= 100 && httpResult < 600) {
+      return httpResult;
+    }
+  }
+  return httpResult;
+}
+
+/**
+ * Start an asynchronous resumable HTTP/S GET from an offset of the resource
+ * (Range header); the data is given by chunks to the sink and/or the callback
+ * with the offset in the resource
+ * Return false if another request is ongoing or if there is no sink nor callback
+ */
+bool SIM800L::beginDownload(const char* url, uint32_t offset, uint16_t serverReadTimeoutMs) {
+  if(httpDataSink == NULL && httpDataCallback == NULL) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : beginDownload() - No sink nor callback for the data"));
+    return false;
+  }
+  if(!startHTTP(HTTP_METHOD_GET, url, NULL, NULL, NULL, 0, serverReadTimeoutMs)) {
+    return false;
+  }
+
+  // Template : Range: bytes=<offset>- (the whole resource from the start)
+  if(offset > 0) {
+    strcpy_P(httpRangeHeader, HTTP_HEADER_RANGE);
+    ultoa(offset, httpRangeHeader + strlen(httpRangeHeader), 10);
+    strcat(httpRangeHeader, "-");
+    httpHeaders = httpRangeHeader;
+  }
+  httpDownload = true;
+  httpDownloadOffset = offset;
+  return true;
+}
+
+/**
+ * Return the offset in the resource of the next byte expected by the
+ * download (the number of bytes received from the start of the resource)
+ */
+uint32_t SIM800L::getDownloadOffset() {
+  return httpDownloadOffset;
+}
+
+/**
+ * Return the total size of the resource being downloaded (known once the
+ * server has answered)
+ */
+uint32_t SIM800L::getDownloadSize() {
+  return httpRangeStart + httpDataLength;
+}
+
+/**
+ * Return the current step of the asynchronous HTTP request
+ */
+HTTPState SIM800L::getHTTPState() {
+  return httpState;
+}
+
+/**
+ * Return the result of the last HTTP request (HTTP status code or error code)
+ */
+uint16_t SIM800L::getHTTPResult() {
+  return httpResult;
+}
+
+/**
+ * Define the callback executed at the end of each asynchronous HTTP request
+ */
+void SIM800L::setHTTPCallback(HTTPCallback callback) {
+  httpCallback = callback;
+}
+
+/**
+ * Meta method to initiate the HTTP/S session on the module
+ * If the session is kept open from a previous request, only the parameters
+ * which have changed are sent again to the module
+ */
+uint16_t SIM800L::initiateHTTP(const char* url, const char* headers) {
+  if(!httpSessionOpen) {
+    // Init HTTP connection
+    sendCommand_P(AT_CMD_HTTPINIT);
+    if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+      if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : initiateHTTP() - Unable to init HTTP"));
+      return 701;
+    }
+
+    // Nothing is defined on a new session (no headers)
+    httpSessionOpen = true;
+    httpSessionSSL = -1;
+    httpHeadersCopy[0] = '\0';
+    httpHeadersKept = true;
+    httpContentTypeKept = false;
+
+    // Use the GPRS bearer
+    sendCommand_P(AT_CMD_HTTPPARA_CID);
+    if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+      if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : initiateHTTP() - Unable to define bearer"));
+      return 7022;  //702
+    }
+  }
+
+  // Define URL to look for (always sent, it is what changes between requests)
+  sendCommand_P(AT_CMD_HTTPPARA_URL, url);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : initiateHTTP() - Unable to define the URL"));
+    return 7023;  //702
+  }
+
+  // Set Headers (or clear the headers of the previous request)
+  if(headers == NULL) {
+    headers = "";
+  }
+  if(!httpHeadersKept || strcmp(headers, httpHeadersCopy) != 0) {
+    sendCommand_P(AT_CMD_HTTPPARA_USERDATA, headers);
+    if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+      if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : initiateHTTP() - Unable to define Headers"));
+      return 7024; //702
+    }
+    httpHeadersKept = keepCopy(httpHeadersCopy, sizeof(httpHeadersCopy), headers);
+  }
+
+  // HTTP or HTTPS, nothing to do if the session is already in the right mode
+  int8_t ssl = strIndex(url, "https://") == 0 ? 1 : 0;
+  if(ssl == httpSessionSSL) {
+    return 0;
+  }
+
+  // Check if the firmware support HTTPSSL command (probed only once)
+  bool isSupportSSL = isSSLSupported();
+  if(LOG_ENABLED(SIM800L_LOG_INFO)) {
+    if(isSupportSSL) {
+      debugStream->println(F("SIM800L : initiateHTTP() - Support of SSL enabled"));
+    } else {
+      debugStream->println(F("SIM800L : initiateHTTP() - Support of SSL disabled (SIM800L firware below R14)"));
+    }
   }
 
   // Send HTTPSSL command only if the version is greater or equals to 14
-  
   if(isSupportSSL) {
-    // HTTP or HTTPS
-    if(strIndex(url, "https://") == 0) {
+    if(ssl == 1) {
       sendCommand_P(AT_CMD_HTTPSSL_Y);
       if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
-        if(enableDebug) debugStream->println(F("SIM800L : initiateHTTP() - Unable to switch to HTTPS"));
+        if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : initiateHTTP() - Unable to switch to HTTPS"));
         return 7025; //702
       }
     } else {
       sendCommand_P(AT_CMD_HTTPSSL_N);
       if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
-        if(enableDebug) debugStream->println(F("SIM800L : initiateHTTP() - Unable to switch to HTTP"));
+        if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : initiateHTTP() - Unable to switch to HTTP"));
         return 7026; //702
       }
     }
   }
+  httpSessionSSL = ssl;
 
   return 0;
 }
@@ -445,446 +1274,2196 @@ uint16_t SIM800L::initiateHTTP(const char* url, const char* headers) {
  * Meta method to terminate the HTTP/S session on the module
  */
 uint16_t SIM800L::terminateHTTP() {
+  // The session is considered as closed even if the module does not answer
+  httpSessionOpen = false;
+
   // Close HTTP connection
+  uint32_t timerStart = millis();
   sendCommand_P(AT_CMD_HTTPTERM);
-  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
-    if(enableDebug) debugStream->println(F("SIM800L : terminateHTTP() - Unable to close HTTP session"));
+  bool terminated = readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK);
+  recordPhase(METRICS_HTTP_TERM, timerStart);
+  if(!terminated) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : terminateHTTP() - Unable to close HTTP session"));
     return 706;
   }
   return 0;
 }
 
 /**
- * Force a reset of the module
+ * Keep the HTTP session open on the module between the requests
+ * The session is closed with closeSession() or after an error
  */
-void SIM800L::reset() {
-  if(pinReset != RESET_PIN_NOT_USED)
-  {
-    // Some logging
-    if(enableDebug) debugStream->println(F("SIM800L : Reset"));
+void SIM800L::setPersistentSession(bool enable) {
+  httpKeepSession = enable;
+}
 
-    // Reset the device
-    digitalWrite(pinReset, HIGH);
-    delay(500);
-    digitalWrite(pinReset, LOW);
-    delay(500);
-    digitalWrite(pinReset, HIGH);
-    delay(1000);
-  } else {
-    // Some logging
-    if(enableDebug) debugStream->println(F("SIM800L : Reset requested but reset pin undefined"));
-    if(enableDebug) debugStream->println(F("SIM800L : No reset"));
+/**
+ * Close the HTTP session kept open by the persistent session mode
+ * Return false if a request is ongoing or if the module refuses to close the session
+ */
+bool SIM800L::closeSession() {
+  if(httpState != HTTP_IDLE && httpState != HTTP_DONE) {
+    return false;
+  }
+  if(!httpSessionOpen) {
+    return true;
   }
+  return terminateHTTP() == 0;
+}
 
-  // Purge the serial
-  stream->flush();
-  while (stream->available()) {
-    stream->read();
+/**
+ * Define the buffer of the caller storing the queue of HTTP requests
+ * (ring buffer of size requests, the requests already queued are dropped)
+ */
+void SIM800L::setHTTPQueue(HTTPRequest* queue, uint8_t size) {
+  httpQueue = queue;
+  httpQueueSize = queue != NULL ? size : 0;
+  httpQueueHead = 0;
+  httpQueueCount = 0;
+}
+
+/**
+ * Add an HTTP/S GET at the end of the queue
+ * Return false if the queue is full
+ */
+bool SIM800L::queueGet(const char* url, const char* headers, uint16_t serverReadTimeoutMs) {
+  return queuePost(url, headers, NULL, NULL, 0, serverReadTimeoutMs);
+}
+
+/**
+ * Add an HTTP/S POST at the end of the queue (GET if the content type is NULL)
+ * Return false if the queue is full
+ */
+bool SIM800L::queuePost(const char* url, const char* headers, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs) {
+  if(httpQueueCount >= httpQueueSize) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : queuePost() - The queue is full"));
+    return false;
   }
+
+  HTTPRequest* request = &httpQueue[(httpQueueHead + httpQueueCount) % httpQueueSize];
+  request->url = url;
+  request->headers = headers;
+  request->contentType = contentType;
+  request->payload = payload;
+  request->clientWriteTimeoutMs = clientWriteTimeoutMs;
+  request->serverReadTimeoutMs = serverReadTimeoutMs;
+  httpQueueCount++;
+  return true;
 }
 
 /**
- * Return the size of data received after the last successful HTTP connection
+ * Number of requests waiting in the queue (including the one being sent)
  */
-uint16_t SIM800L::getDataSizeReceived() {
-  return dataSize;
+uint8_t SIM800L::getQueueLength() {
+  return httpQueueCount;
 }
 
 /**
- * Return the buffer of data received after the last successful HTTP connection
+ * Start to send the requests of the queue asynchronously, the requests are
+ * driven one after the other by poll() in the same HTTP session
+ * Return false if the queue is empty or if another request is ongoing
  */
-char* SIM800L::getDataReceived() {
-  return recvBuffer;
+bool SIM800L::beginQueue() {
+  if(httpQueueCount == 0 || httpQueueDraining) {
+    return false;
+  }
+
+  httpQueueKeepSession = httpKeepSession;
+  httpQueueSucceeded = 0;
+  httpKeepSession = true;
+  if(!startQueuedHTTP()) {
+    httpKeepSession = httpQueueKeepSession;
+    return false;
+  }
+  httpQueueDraining = true;
+  return true;
+}
+
+/**
+ * Send all the requests of the queue in the same HTTP session
+ * Blocking version of beginQueue()
+ * Return the number of requests successful (HTTP status code 2xx)
+ */
+uint8_t SIM800L::sendQueue() {
+  if(!beginQueue()) {
+    return 0;
+  }
+  while(poll());
+  return httpQueueSucceeded;
+}
+
+/**
+ * Define the callback receiving the result of each request of the queue
+ * (the data received is available in the callback as for the other requests)
+ */
+void SIM800L::setHTTPQueueCallback(HTTPQueueCallback callback) {
+  httpQueueCallback = callback;
+}
+
+/**
+ * Force a reset of the module
+ */
+void SIM800L::reset() {
+  if(pinReset != (uint8_t)RESET_PIN_NOT_USED)
+  {
+    // Some logging
+    if(LOG_ENABLED(SIM800L_LOG_INFO)) debugStream->println(F("SIM800L : Reset"));
+
+    // Reset the device
+    digitalWrite(pinReset, HIGH);
+    delay(500);
+    digitalWrite(pinReset, LOW);
+    delay(500);
+    digitalWrite(pinReset, HIGH);
+    delay(1000);
+
+    // The module has forgotten everything
+    httpSessionOpen = false;
+    bearerStatus = BEARER_UNKNOWN;
+    slowClockMode = 0;
+    compactMode = false;
+  } else {
+    // Some logging
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : Reset requested but reset pin undefined"));
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : No reset"));
+  }
+
+  // Purge the serial
+  stream->flush();
+  while (stream->available()) {
+    readFromModule();
+  }
+}
+
+/**
+ * Return the size of data received after the last successful HTTP connection
+ */
+uint16_t SIM800L::getDataSizeReceived() {
+  return dataSize;
+}
+
+/**
+ * Return the buffer of data received after the last successful HTTP connection
+ */
+char* SIM800L::getDataReceived() {
+  return recvBuffer;
+}
+
+/**
+ * Status function: Check if AT command works
+ */
+bool SIM800L::isReady() {
+  return checkLink(DEFAULT_TIMEOUT);
+}
+
+/**
+ * Check if AT command works within a specific timeout
+ */
+bool SIM800L::checkLink(uint16_t timeout) {
+  sendCommand_P(AT_CMD_BASE);
+  return readResponseCheckAnswer_P(timeout, AT_RSP_OK);
+}
+
+/**
+ * Switch the serial line of the module (AT+IPR) and of the host to another
+ * baud rate, then verify the link; if the link doesn't work at the new baud
+ * rate, go back to the previous one
+ * The host side is switched by the function given (i.e. calling Serial1.begin())
+ * Return true if the link works at the new baud rate
+ */
+bool SIM800L::setBaudRate(uint32_t rate, BaudRateSetter setHostBaudRate) {
+  if(rate == baudRate) {
+    return true;
+  }
+
+  // The OK is sent by the module at the current baud rate
+  sendCommand_P(AT_CMD_IPR, rate);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : setBaudRate() - Baud rate refused by the module"));
+    return false;
+  }
+
+  // Switch the host and verify the link a few times
+  setHostBaudRate(rate);
+  delay(100);
+  bool reliable = true;
+  for(uint8_t i = 0; i < 3 && reliable; i++) {
+    reliable = checkLink(1000);
+  }
+
+  if(reliable) {
+    if(LOG_ENABLED(SIM800L_LOG_INFO)) {
+      debugStream->print(F("SIM800L : setBaudRate() - Link switched to "));
+      debugStream->println(rate);
+    }
+    baudRate = rate;
+    return true;
+  }
+
+  // Fallback on the previous baud rate
+  if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : setBaudRate() - Link not reliable, go back to the previous baud rate"));
+  sendCommand_P(AT_CMD_IPR, baudRate);
+  delay(100);
+  setHostBaudRate(baudRate);
+  delay(100);
+  checkLink(1000);
+  return false;
+}
+
+/**
+ * Switch the module and the host to the fastest baud rate with a reliable
+ * link, up to a maximum (i.e. 57600 for SoftwareSerial)
+ * Return the baud rate in use at the end
+ */
+uint32_t SIM800L::negotiateBaudRate(BaudRateSetter setHostBaudRate, uint32_t maxRate) {
+  for(uint8_t i = 0; i < BAUD_RATES_COUNT; i++) {
+    uint32_t rate = pgm_read_dword(&BAUD_RATES[i]);
+    if(rate > maxRate) {
+      continue;
+    }
+    if(rate <= baudRate || setBaudRate(rate, setHostBaudRate)) {
+      break;
+    }
+  }
+  return baudRate;
+}
+
+/**
+ * Find the baud rate of the module by trying all the baud rates on the host
+ * (the module is detecting the baud rate by itself on AT if auto-bauding)
+ * Return the baud rate found or 0 if the module doesn't answer
+ */
+uint32_t SIM800L::detectBaudRate(BaudRateSetter setHostBaudRate) {
+  for(uint8_t i = 0; i < BAUD_RATES_COUNT; i++) {
+    uint32_t rate = pgm_read_dword(&BAUD_RATES[i]);
+    setHostBaudRate(rate);
+    delay(100);
+    // First AT is used by the module to synchronize in auto-bauding
+    checkLink(500);
+    if(checkLink(500)) {
+      if(LOG_ENABLED(SIM800L_LOG_INFO)) {
+        debugStream->print(F("SIM800L : detectBaudRate() - Module found at "));
+        debugStream->println(rate);
+      }
+      baudRate = rate;
+      return rate;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Return the baud rate of the serial line known by the driver
+ */
+uint32_t SIM800L::getBaudRate() {
+  return baudRate;
+}
+
+/**
+ * Status function: Check the power mode
+ */
+PowerMode SIM800L::getPowerMode() {
+  char* value;
+  if(!queryStatus(QUERY_POWER_MODE, &value)) {
+    return POW_ERROR;
+  }
+  if(value == NULL) {
+    return POW_UNKNOWN;
+  }
+
+  // Prepare the clear output
+  switch(value[0]) {
+    case '0' : return MINIMUM;
+    case '1' : return NORMAL;
+    case '4' : return SLEEP;
+    default  : return POW_UNKNOWN;
+  }
+}
+
+/**
+ * Status function: Get version of the module
+ */
+char* SIM800L::getVersion() {
+  char* value;
+  if(!queryStatus(QUERY_VERSION, &value) || value == NULL) {
+    return NULL;
+  }
+
+  // Store it on the recv buffer (not used at the moment)
+  return copyToRecvBuffer(value, strlen(value));
+}
+
+/**
+ * Probe the capabilities of the module once (model, firmware release and
+ * support of SSL) from the answer of ATI, without using the reception buffer
+ * Return true if the capabilities are known
+ */
+bool SIM800L::probeCapabilities() {
+  if(capabilitiesProbed) {
+    return true;
+  }
+
+  char* value;
+  if(!queryStatus(QUERY_VERSION, &value) || value == NULL) {
+    return false;
+  }
+
+  // Extract the model (i.e. "SIM800 R14.18")
+  uint8_t i = 0;
+  for(; i < sizeof(moduleModel) - 1 && value[i] != ' ' && value[i] != '\0'; i++) {
+    moduleModel[i] = value[i];
+  }
+  moduleModel[i] = '\0';
+
+  // Extract the release of the firmware
+  firmwareRelease = 0;
+  char* release = strchr(value + i, 'R');
+  if(release != NULL) {
+    for(release++; *release >= '0' && *release <= '9'; release++) {
+      firmwareRelease = firmwareRelease * 10 + (*release - '0');
+    }
+  }
+
+  // The release should be greater or equals to 14 to support SSL stack
+  sslSupported = firmwareRelease >= 14;
+  capabilitiesProbed = true;
+
+  if(LOG_ENABLED(SIM800L_LOG_INFO)) {
+    debugStream->print(F("SIM800L : probeCapabilities() - Module "));
+    debugStream->print(moduleModel);
+    debugStream->print(F(" release "));
+    debugStream->println(firmwareRelease);
+  }
+  return true;
+}
+
+/**
+ * Capabilities: Check if the firmware supports SSL (release R14 and above)
+ */
+bool SIM800L::isSSLSupported() {
+  probeCapabilities();
+  return sslSupported;
+}
+
+/**
+ * Capabilities: Get the release number of the firmware (i.e. 14 for R14.18)
+ * Return 0 if unknown
+ */
+uint8_t SIM800L::getFirmwareRelease() {
+  probeCapabilities();
+  return firmwareRelease;
+}
+
+/**
+ * Capabilities: Get the model of the module (i.e. "SIM800")
+ * Return an empty string if unknown
+ */
+const char* SIM800L::getModel() {
+  probeCapabilities();
+  return moduleModel;
+}
+
+/**
+ * Status function: Get firmware version
+ */
+char* SIM800L::getFirmware() {
+  char* value;
+  if(!queryStatus(QUERY_FIRMWARE, &value) || value == NULL) {
+    return NULL;
+  }
+
+  // Store it on the recv buffer (not used at the moment)
+  return copyToRecvBuffer(value, strlen(value));
+}
+
+/**
+ * Status function: Requests the simcard number
+ */
+char* SIM800L::getSimCardNumber() {
+  char* value;
+  if(!queryStatus(QUERY_SIM_CARD, &value) || value == NULL) {
+    return NULL;
+  }
+
+  // Store it on the recv buffer (not used at the moment)
+  return copyToRecvBuffer(value, strlen(value));
+}
+
+/**
+ * Status function: Check if the module is registered on the network
+ */
+NetworkRegistration SIM800L::getRegistrationStatus() {
+  char* value;
+  if(!queryStatus(QUERY_REGISTRATION, &value)) {
+    return NET_ERROR;
+  }
+
+  // Template : <n>,<stat>
+  value = value != NULL ? strchr(value, ',') : NULL;
+  if(value == NULL) {
+    return NET_UNKNOWN;
+  }
+  return toNetworkRegistration(value[1]);
+}
+
+/**
+ * Status function: Check the registration, the signal and the GPRS attachment
+ * with one chained command (AT+CREG?;+CSQ;+CGATT?) parsed in one pass
+ */
+NetworkSnapshot SIM800L::getNetworkSnapshot() {
+  NetworkSnapshot snapshot;
+  snapshot.valid = false;
+  snapshot.registration = NET_ERROR;
+  snapshot.signal = 0;
+  snapshot.attached = false;
+  snapshot.ready = false;
+
+  // The module stops at the first command failing and answers ERROR
+  sendCommand_P(AT_CMD_NETWORK);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : getNetworkSnapshot() - Unable to get the status of the network"));
+    return snapshot;
+  }
+
+  // Template : +CREG: <n>,<stat>
+  int16_t cregIdx = strIndex(internalBuffer, "+CREG: ");
+  const char* value = cregIdx >= 0 ? strchr(internalBuffer + cregIdx, ',') : NULL;
+  snapshot.registration = value != NULL ? toNetworkRegistration(value[1]) : NET_UNKNOWN;
+
+  // Template : +CSQ: <rssi>,<ber> (99 if unknown)
+  int16_t csqIdx = strIndex(internalBuffer, "+CSQ: ");
+  if(csqIdx >= 0) {
+    uint8_t signal = atoi(internalBuffer + csqIdx + 6);
+    snapshot.signal = signal <= 31 ? signal : 0;
+  }
+
+  // Template : +CGATT: <state>
+  int16_t cgattIdx = strIndex(internalBuffer, "+CGATT: ");
+  if(cgattIdx >= 0) {
+    snapshot.attached = internalBuffer[cgattIdx + 8] == '1';
+  }
+
+  snapshot.valid = cregIdx >= 0 && csqIdx >= 0 && cgattIdx >= 0;
+  snapshot.ready = snapshot.valid && snapshot.signal > 0 && snapshot.attached &&
+                   (snapshot.registration == REGISTERED_HOME || snapshot.registration == REGISTERED_ROAMING);
+  return snapshot;
+}
+
+/**
+ * Status function: Send a query of the table STATUS_QUERIES and read the
+ * answer until OK. The value is searched at the start of the lines only (the
+ * echo of the command, if any, is skipped) and left in the internal buffer.
+ * Return false on error or timeout, value is NULL if no line holds it
+ */
+bool SIM800L::queryStatus(uint8_t queryId, char** value) {
+  StatusQuery query;
+  memcpy_P(&query, &STATUS_QUERIES[queryId], sizeof(query));
+  *value = NULL;
+
+  sendCommand_P(query.command);
+  if(!readResponseCheckAnswer_P(query.timeout, AT_RSP_OK)) {
+    return false;
+  }
+
+  uint8_t answerSize = query.answer != NULL ? strlen_P(query.answer) : 0;
+  uint8_t commandSize = strlen_P(query.command);
+  char* line = internalBuffer;
+  while(*line != '\0') {
+    // Isolate the line (CR and LF are both separators, the echo ends with CR only)
+    char* next = strpbrk(line, "\r\n");
+    if(next != NULL) {
+      *next++ = '\0';
+    } else {
+      next = line + strlen(line);
+    }
+
+    if(query.answer != NULL) {
+      if(strncmp_P(line, query.answer, answerSize) == 0) {
+        *value = line + answerSize;
+        return true;
+      }
+    } else if(line[0] != '\0' && strncmp_P(line, query.command, commandSize) != 0 &&
+              strcmp_P(line, AT_RSP_OK) != 0 && strcmp_P(line, AT_RSP_OK_CODE) != 0) {
+      *value = line;
+      return true;
+    }
+    line = next;
+  }
+
+  if(LOG_ENABLED(SIM800L_LOG_INFO)) debugStream->println(F("SIM800L : queryStatus() - No value in the answer"));
+  return true;
+}
+
+/**
+ * Convert the status of the registration received from the module to the
+ * clear output
+ */
+NetworkRegistration SIM800L::toNetworkRegistration(char value) {
+  switch(value) {
+    case '0' : return NOT_REGISTERED;
+    case '1' : return REGISTERED_HOME;
+    case '2' : return SEARCHING;
+    case '3' : return DENIED;
+    case '5' : return REGISTERED_ROAMING;
+    default  : return NET_UNKNOWN;
+  }
+}
+
+/**
+ * Setup the GPRS connectivity
+ * As input, give the APN string of the operator
+ */
+bool SIM800L::setupGPRS(const char* apn) {
+  // Prepare the GPRS connection as the bearer
+  sendCommand_P(AT_CMD_SAPBR_GPRS);
+  if(!readResponseCheckAnswer_P(20000, AT_RSP_OK)) {
+    return false;
+  }
+
+  // Set the config of the bearer with the APN
+  sendCommand_P(AT_CMD_SAPBR_APN, apn);
+  return readResponseCheckAnswer_P(20000, AT_RSP_OK);
+}
+
+/**
+ * Open the GPRS connectivity
+ */
+bool SIM800L::connectGPRS() {
+  uint32_t timerStart = millis();
+  sendCommand_P(AT_CMD_SAPBR1);
+  // Timout is max 85 seconds according to SIM800 specifications
+  // We will wait for 65s to be within uint16_t
+  if(readResponseCheckAnswer_P(65000, AT_RSP_OK)) {
+    recordPhase(METRICS_GPRS_CONNECT, timerStart);
+    bearerStatus = BEARER_CONNECTED;
+    bearerIP[0] = '\0';
+    return true;
+  }
+
+  // The module answers ERROR if the bearer is already connected
+  return getBearerStatus() == BEARER_CONNECTED;
+}
+
+/**
+ * Close the GPRS connectivity
+ */
+bool SIM800L::disconnectGPRS() {
+  sendCommand_P(AT_CMD_SAPBR0);
+  // Timout is max 65 seconds according to SIM800 specifications
+  if(!readResponseCheckAnswer_P(65000, AT_RSP_OK)) {
+    bearerStatus = BEARER_UNKNOWN;
+    return false;
+  }
+  bearerStatus = BEARER_CLOSED;
+  bearerIP[0] = '\0';
+  return true;
+}
+
+/**
+ * Query the status of the GPRS bearer and the IP address assigned
+ * (template : +SAPBR: 1,<status>,"<ip>")
+ */
+BearerStatus SIM800L::getBearerStatus() {
+  sendCommand_P(AT_CMD_SAPBR2);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_SAPBR2)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : getBearerStatus() - Unable to get the status of the bearer"));
+    bearerStatus = BEARER_UNKNOWN;
+    return bearerStatus;
+  }
+
+  int16_t idx = strIndex(internalBuffer, "+SAPBR: 1,");
+  if(idx < 0) {
+    bearerStatus = BEARER_UNKNOWN;
+    return bearerStatus;
+  }
+  const char* value = internalBuffer + idx + 10;
+  uint8_t status = atoi(value);
+  bearerStatus = status <= BEARER_CLOSED ? (BearerStatus)status : BEARER_UNKNOWN;
+
+  // Copy the IP address between the quotes
+  bearerIP[0] = '\0';
+  value = strchr(value, '"');
+  if(value != NULL) {
+    value++;
+    uint8_t i = 0;
+    while(value[i] != '"' && value[i] != '\0' && i < sizeof(bearerIP) - 1) {
+      bearerIP[i] = value[i];
+      i++;
+    }
+    bearerIP[i] = '\0';
+  }
+
+  // Final OK
+  readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK);
+  return bearerStatus;
+}
+
+/**
+ * IP address assigned to the GPRS bearer on the last query of the status
+ * (empty if unknown)
+ */
+const char* SIM800L::getBearerIP() {
+  return bearerIP;
+}
+
+/**
+ * Last status known of the GPRS bearer, without any command to the module
+ * (the status is updated by the commands of the driver and when the network
+ * closes the bearer)
+ */
+bool SIM800L::isGPRSConnected() {
+  processURC();
+  return bearerStatus == BEARER_CONNECTED;
+}
+
+/**
+ * Connect the GPRS bearer only if needed: the status is queried only if it is
+ * not known and the bearer is connected only if it is not already connected
+ * (the connection may take up to 65s)
+ */
+bool SIM800L::ensureGPRS() {
+  processURC();
+  if(bearerStatus != BEARER_CONNECTED && bearerStatus != BEARER_CLOSED) {
+    getBearerStatus();
+  }
+  if(bearerStatus == BEARER_CONNECTED) {
+    return true;
+  }
+  if(LOG_ENABLED(SIM800L_LOG_INFO)) debugStream->println(F("SIM800L : ensureGPRS() - Connect the bearer"));
+  return connectGPRS();
+}
+
+/**
+ * Connect the GPRS bearer if needed at the start of each HTTP request
+ */
+void SIM800L::setAutoConnectGPRS(bool enable) {
+  autoConnectGPRS = enable;
+}
+
+/**
+ * Setup the IP context used by the raw sockets and bring it up
+ * As input, give the APN string of the operator and the connection mode
+ * (single connection or up to SOCKET_MAX_CONNECTIONS connections)
+ * The data received is kept by the module until receiveSocket() is called
+ */
+bool SIM800L::setupIP(const char* apn, bool multiConnection) {
+  // The mode can only be changed without IP context
+  sendCommand_P(AT_CMD_CIPSHUT);
+  if(!readResponseCheckAnswer_P(65000, AT_RSP_SHUT_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : setupIP() - Unable to shutdown the IP context"));
+    return false;
+  }
+  for(uint8_t i = 0; i < SOCKET_MAX_CONNECTIONS; i++) {
+    socketStates[i] = SOCKET_CLOSED;
+  }
+  socketDataFlags = 0;
+
+  sendCommand_P(multiConnection ? AT_CMD_CIPMUX1 : AT_CMD_CIPMUX0);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : setupIP() - Unable to define the connection mode"));
+    return false;
+  }
+  socketMultiConnection = multiConnection;
+
+  sendCommand_P(AT_CMD_CIPRXGET1);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : setupIP() - Unable to enable the manual reception"));
+    return false;
+  }
+
+  sendCommand_P(AT_CMD_CSTT, apn);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : setupIP() - Unable to define the APN"));
+    return false;
+  }
+
+  // Timout is max 85 seconds according to SIM800 specifications
+  // We will wait for 65s to be within uint16_t
+  sendCommand_P(AT_CMD_CIICR);
+  if(!readResponseCheckAnswer_P(65000, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : setupIP() - Unable to bring up the wireless connection"));
+    return false;
+  }
+
+  // The local IP address is the only answer (no OK), the IP context is
+  // ready once it has been read
+  sendCommand_P(AT_CMD_CIFSR);
+  if(!readResponse(DEFAULT_TIMEOUT, compactMode ? 1 : 2) || strIndex(internalBuffer, "ERROR") >= 0) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : setupIP() - Unable to get the local IP address"));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Close all the sockets and the IP context
+ */
+bool SIM800L::disconnectIP() {
+  sendCommand_P(AT_CMD_CIPSHUT);
+  bool shut = readResponseCheckAnswer_P(65000, AT_RSP_SHUT_OK);
+  for(uint8_t i = 0; i < SOCKET_MAX_CONNECTIONS; i++) {
+    socketStates[i] = SOCKET_CLOSED;
+  }
+  socketDataFlags = 0;
+  return shut;
+}
+
+/**
+ * Open a TCP or UDP connection to a host and wait until the connection is
+ * established (timeout in millisec)
+ */
+bool SIM800L::connectSocket(uint8_t id, SocketProtocol protocol, const char* host, uint16_t port, uint16_t timeoutMs) {
+  if(!socketMultiConnection) {
+    id = 0;
+  }
+  if(id >= SOCKET_MAX_CONNECTIONS) {
+    return false;
+  }
+
+  // Template : AT+CIPSTART=[<id>,]"TCP","<host>",<port>
+  beginCommand_P(AT_CMD_CIPSTART);
+  if(socketMultiConnection) {
+    appendCommand(id);
+    appendCommand(",");
+  }
+  appendCommand(protocol == SOCKET_UDP ? "\"UDP\",\"" : "\"TCP\",\"");
+  appendCommand(host);
+  appendCommand("\",");
+  appendCommand(port);
+  socketStates[id] = SOCKET_CONNECTING;
+  socketDataFlags &= ~(1 << id);
+  endCommand();
+
+  // The connection is established after the OK (CONNECT OK is dispatched as unsolicited message)
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(socketStates[id] == SOCKET_CONNECTED) {
+      // ALREADY CONNECT
+      return true;
+    }
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : connectSocket() - Unable to open the connection"));
+    socketStates[id] = SOCKET_FAILED;
+    return false;
+  }
+
+  if(!waitSocketState(id, SOCKET_CONNECTING, timeoutMs)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : connectSocket() - Timeout while connecting"));
+    socketStates[id] = SOCKET_FAILED;
+    return false;
+  }
+  return socketStates[id] == SOCKET_CONNECTED;
+}
+
+/**
+ * Send data on an open connection and wait until the module confirms the
+ * sending (timeout in millisec)
+ */
+bool SIM800L::sendSocket(uint8_t id, const uint8_t* data, uint16_t size, uint16_t timeoutMs) {
+  if(!socketMultiConnection) {
+    id = 0;
+  }
+  if(id >= SOCKET_MAX_CONNECTIONS || socketStates[id] != SOCKET_CONNECTED) {
+    return false;
+  }
+
+  if(socketMultiConnection) {
+    sendCommand_P(AT_CMD_CIPSEND, id, size);
+  } else {
+    sendCommand_P(AT_CMD_CIPSEND, size);
+  }
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_PROMPT)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : sendSocket() - The module is not ready to receive the data"));
+    return false;
+  }
+
+  socketSendStatus = 0;
+  if(!writeToModule(data, size)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : sendSocket() - The module doesn't accept the data"));
+    return false;
+  }
+
+  // SEND OK or SEND FAIL is dispatched as unsolicited message
+  uint32_t timerStart = millis();
+  while(socketSendStatus == 0 && socketStates[id] == SOCKET_CONNECTED) {
+    if(!waitData(timerStart, timeoutMs)) {
+      if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : sendSocket() - Timeout while sending"));
+      return false;
+    }
+    processURC();
+  }
+  return socketSendStatus > 0;
+}
+
+/**
+ * Check if the module holds data received on a connection
+ * (the unsolicited messages are dispatched first)
+ */
+bool SIM800L::isSocketDataAvailable(uint8_t id) {
+  if(!socketMultiConnection) {
+    id = 0;
+  }
+  if(id >= SOCKET_MAX_CONNECTIONS) {
+    return false;
+  }
+  processURC();
+  return (socketDataFlags & (1 << id)) != 0;
+}
+
+/**
+ * Read at most size bytes of the data received on a connection
+ * Return the number of bytes read (0 if nothing is pending) or -1 on error
+ */
+int16_t SIM800L::receiveSocket(uint8_t id, uint8_t* buffer, uint16_t size) {
+  if(!socketMultiConnection) {
+    id = 0;
+  }
+  if(id >= SOCKET_MAX_CONNECTIONS) {
+    return -1;
+  }
+  if(size > SOCKET_MAX_READ) {
+    size = SOCKET_MAX_READ;
+  }
+
+  if(socketMultiConnection) {
+    sendCommand_P(AT_CMD_CIPRXGET2, id, size);
+  } else {
+    sendCommand_P(AT_CMD_CIPRXGET2, size);
+  }
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_CIPRXGET2)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : receiveSocket() - Unable to read the data"));
+    return -1;
+  }
+
+  // Template : +CIPRXGET: 2,[<id>,]<size read>,<size still pending>
+  int16_t idx = strIndex(internalBuffer, "+CIPRXGET: 2,");
+  if(idx < 0) {
+    return -1;
+  }
+  char* value = internalBuffer + idx + 13;
+  if(socketMultiConnection) {
+    value = strchr(value, ',');
+    if(value == NULL) {
+      return -1;
+    }
+    value++;
+  }
+  uint16_t sizeRead = strtoul(value, &value, 10);
+  uint16_t sizePending = *value == ',' ? strtoul(value + 1, NULL, 10) : 0;
+  if(sizeRead > size) {
+    return -1;
+  }
+
+  if(!readRawData((char*)buffer, sizeRead)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : receiveSocket() - Timeout while reading the data"));
+    return -1;
+  }
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : receiveSocket() - Invalid end of data"));
+    return -1;
+  }
+
+  if(sizePending == 0) {
+    socketDataFlags &= ~(1 << id);
+  }
+  return sizeRead;
+}
+
+/**
+ * Close a connection and wait for the confirmation of the module
+ */
+bool SIM800L::closeSocket(uint8_t id) {
+  if(!socketMultiConnection) {
+    id = 0;
+  }
+  if(id >= SOCKET_MAX_CONNECTIONS) {
+    return false;
+  }
+  if(socketStates[id] != SOCKET_CONNECTED) {
+    socketStates[id] = SOCKET_CLOSED;
+    return true;
+  }
+
+  if(socketMultiConnection) {
+    sendCommand_P(AT_CMD_CIPCLOSE_ID, id);
+  } else {
+    sendCommand_P(AT_CMD_CIPCLOSE);
+  }
+
+  // CLOSE OK is dispatched as unsolicited message
+  bool closed = waitSocketState(id, SOCKET_CONNECTED, DEFAULT_TIMEOUT);
+  socketStates[id] = SOCKET_CLOSED;
+  socketDataFlags &= ~(1 << id);
+  return closed;
+}
+
+/**
+ * Status of a connection as known from the last messages of the module
+ */
+SocketState SIM800L::getSocketState(uint8_t id) {
+  if(!socketMultiConnection) {
+    id = 0;
+  }
+  if(id >= SOCKET_MAX_CONNECTIONS) {
+    return SOCKET_CLOSED;
+  }
+  processURC();
+  return socketStates[id];
+}
+
+/**
+ * Wait until the state of a connection changes from the pending state
+ * (the answers of the module are dispatched as unsolicited messages)
+ * False on timeout
+ */
+bool SIM800L::waitSocketState(uint8_t id, SocketState pendingState, uint16_t timeout) {
+  uint32_t timerStart = millis();
+  processURC();
+  while(socketStates[id] == pendingState) {
+    if(!waitData(timerStart, timeout)) {
+      return false;
+    }
+    processURC();
+  }
+  return true;
+}
+
+/**
+ * Define an SSL option of the module (AT+SSLOPT=<option>,<enable>)
+ * The options are kept by the module for the next HTTPS requests, so they are
+ * defined once and not by request
+ */
+bool SIM800L::setSSLOption(SSLOption option, bool enable) {
+  if(!isSSLSupported()) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : setSSLOption() - SSL not supported by the firmware"));
+    return false;
+  }
+  sendCommand_P(AT_CMD_SSLOPT, (uint32_t)option, enable ? 1 : 0);
+  return readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK);
+}
+
+/**
+ * Write a certificate (i.e. CA certificate in PEM or DER) in the file system
+ * of the module, in C:\USER\<fileName>; an existing file is overwritten
+ */
+bool SIM800L::loadCertificate(const char* fileName, const uint8_t* data, uint16_t size) {
+  if(!beginWriteFile(fileName, false, size)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : loadCertificate() - Unable to write the file"));
+    return false;
+  }
+
+  if(!writeToModule(data, size)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : loadCertificate() - The module doesn't accept the data"));
+    return false;
+  }
+  return readResponseCheckAnswer_P(10000, AT_RSP_OK);
+}
+
+/**
+ * Use a certificate of the file system of the module for SSL
+ * (AT+SSLSETCERT="C:\USER\<fileName>"[,"<password>"])
+ */
+bool SIM800L::setSSLCertificate(const char* fileName, const char* password) {
+  beginCommand_P(AT_CMD_SSLSETCERT);
+  appendCommand(fileName);
+  appendCommand("\"");
+  if(password != NULL) {
+    appendCommand(",\"");
+    appendCommand(password);
+    appendCommand("\"");
+  }
+  endCommand();
+
+  // The result is given after the OK (template : +SSLSETCERT: <result>)
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_SSLSETCERT)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : setSSLCertificate() - Certificate refused by the module"));
+    return false;
+  }
+  int16_t idx = strIndex(internalBuffer, "+SSLSETCERT: ");
+  return idx >= 0 && internalBuffer[idx + 13] == '0';
+}
+
+/**
+ * Start to write a file in the file system of the module, in
+ * C:\USER\<fileName> (created if needed), from the start or at the end
+ * The existence of the file is checked only for the first write of a file
+ * True once the module waits for the size bytes of data
+ */
+bool SIM800L::beginWriteFile(const char* fileName, bool append, uint16_t size) {
+  if(strcmp(fileName, existingFileName) != 0) {
+    // The module answers ERROR to AT+FSCREATE for an existing file, so the
+    // file is created only if it has no size (missing)
+    beginCommand_P(AT_CMD_FSFLSIZE);
+    appendCommand(fileName);
+    endCommand();
+    if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_FSFLSIZE)) {
+      beginCommand_P(AT_CMD_FSCREATE);
+      appendCommand(fileName);
+      endCommand();
+      if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+        if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : beginWriteFile() - Unable to create the file"));
+        return false;
+      }
+    }
+    keepCopy(existingFileName, sizeof(existingFileName), fileName);
+  }
+
+  // Template : AT+FSWRITE=C:\USER\<fileName>,<mode 0 = from the start, 1 = append>,<size>,<input time in s>
+  beginCommand_P(AT_CMD_FSWRITE);
+  appendCommand(fileName);
+  appendCommand(append ? ",1," : ",0,");
+  appendCommand(size);
+  appendCommand(",10");
+  endCommand();
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_FS_PROMPT)) {
+    // Checked again on the next write (i.e. the file was deleted meanwhile)
+    existingFileName[0] = '\0';
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Read a part of a file of the file system of the module into a buffer
+ * (AT+FSREAD=C:\USER\<fileName>,1,<size>,<position>), the data follows the
+ * line of the command
+ */
+bool SIM800L::readFile(const char* fileName, uint32_t position, char* buffer, uint16_t size) {
+  beginCommand_P(AT_CMD_FSREAD);
+  appendCommand(fileName);
+  appendCommand(",1,");
+  appendCommand(size);
+  appendCommand(",");
+  appendCommand(position);
+  endCommand();
+
+  // Skip the end of the line before the data (no line in compact mode)
+  uint32_t timerStart = millis();
+  while(!compactMode) {
+    if(!waitData(timerStart, DEFAULT_TIMEOUT)) {
+      return false;
+    }
+    char c = readFromModule();
+    if(c == '\n') {
+      break;
+    }
+  }
+
+  if(!readRawData(buffer, size)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : readFile() - Timeout while reading the file"));
+    return false;
+  }
+  return readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK);
+}
+
+/**
+ * Store-and-forward: append a record (a line of text) to a file of the file
+ * system of the module, i.e. while the network is not available
+ */
+bool SIM800L::storeRecord(const char* fileName, const char* record) {
+  uint16_t size = strlen(record);
+  if(!beginWriteFile(fileName, true, size + 1)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : storeRecord() - Unable to write the file"));
+    return false;
+  }
+
+  // The records are separated by LF
+  if(!writeToModule((const uint8_t*)record, size) || !writeToModule((const uint8_t*)"\n", 1)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : storeRecord() - The module doesn't accept the data"));
+    return false;
+  }
+  return readResponseCheckAnswer_P(10000, AT_RSP_OK);
+}
+
+/**
+ * Store-and-forward: return the size of the records stored in a file of the
+ * file system of the module (0 if there is no file)
+ */
+uint32_t SIM800L::getStoredSize(const char* fileName) {
+  beginCommand_P(AT_CMD_FSFLSIZE);
+  appendCommand(fileName);
+  endCommand();
+
+  // Template : +FSFLSIZE: <size>
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_FSFLSIZE)) {
+    return 0;
+  }
+  int16_t idx = strIndex(internalBuffer, "+FSFLSIZE: ");
+  return idx >= 0 ? strtoul(internalBuffer + idx + 11, NULL, 10) : 0;
+}
+
+/**
+ * Store-and-forward: post the records stored in a file of the file system of
+ * the module. The module can't feed AT+HTTPDATA from a file, so the file is
+ * read by parts of whole records (limited by the reception buffer), each part
+ * is posted in the same HTTP session and the file is deleted once all the
+ * parts are accepted (2xx). After a failure, the next upload of the file
+ * starts at the first part not accepted
+ * Return the HTTP status code of the last part, 0 if nothing is stored, or
+ * the error code of the driver (711 if the file can't be read)
+ */
+uint16_t SIM800L::postStored(const char* url, const char* headers, const char* contentType, const char* fileName, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs) {
+  uint32_t fileSize = getStoredSize(fileName);
+  if(fileSize == 0) {
+    if(LOG_ENABLED(SIM800L_LOG_INFO)) debugStream->println(F("SIM800L : postStored() - Nothing stored"));
+    return 0;
+  }
+
+  // The parts are read in the reception buffer (with the final \0)
+  if(recvBufferSize < 2) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : postStored() - Reception buffer not allocated"));
+    return 711;
+  }
+
+  // Resume after the parts already accepted for this file
+  uint32_t position = strcmp(fileName, storedFileName) == 0 && storedFileOffset < fileSize ? storedFileOffset : 0;
+  if(position > 0) {
+    metrics.retries++;
+  }
+
+  // The parts are sent in one HTTP session
+  bool keepSession = httpKeepSession;
+  httpKeepSession = true;
+  uint16_t rc = 0;
+  while(position < fileSize) {
+    if(!startHTTP(HTTP_METHOD_POST, url, headers, contentType, NULL, clientWriteTimeoutMs, serverReadTimeoutMs)) {
+      rc = 700;
+      break;
+    }
+
+    // Read the next part in the reception buffer (kept until the data is uploaded)
+    uint16_t size = recvBufferSize - 1;
+    if(fileSize - position < size) {
+      size = fileSize - position;
+    }
+    if(!readFile(fileName, position, recvBuffer, size)) {
+      if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : postStored() - Unable to read the file"));
+      httpState = HTTP_IDLE;
+      rc = 711;
+      break;
+    }
+
+    // Cut the part after the last complete record (a record bigger than the buffer is cut anyway)
+    if(position + size < fileSize) {
+      uint16_t end = size;
+      while(end > 0 && recvBuffer[end - 1] != '\n') {
+        end--;
+      }
+      if(end > 0) {
+        size = end;
+      }
+    }
+    recvBuffer[size] = '\0';
+    httpPayload = recvBuffer;
+    httpPayloadSize = size;
+
+    while(poll());
+    rc = httpResult;
+    if(rc < 200 || rc >= 300) {
+      break;
+    }
+    position += size;
+  }
+
+  httpKeepSession = keepSession;
+  if(!httpKeepSession && httpSessionOpen) {
+    terminateHTTP();
+  }
+
+  // Keep the progress for the next upload (not if the name is too long to be kept) or forget the file once sent
+  storedFileOffset = keepCopy(storedFileName, sizeof(storedFileName), fileName) ? position : 0;
+  if(position >= fileSize) {
+    deleteStored(fileName);
+  }
+  return rc;
+}
+
+/**
+ * Store-and-forward: delete the file of the records stored
+ */
+bool SIM800L::deleteStored(const char* fileName) {
+  if(strcmp(fileName, storedFileName) == 0) {
+    storedFileOffset = 0;
+  }
+  if(strcmp(fileName, existingFileName) == 0) {
+    existingFileName[0] = '\0';
+  }
+  beginCommand_P(AT_CMD_FSDEL);
+  appendCommand(fileName);
+  endCommand();
+  return readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK);
+}
+
+/**
+ * Enable the hardware flow control (AT+IFC=2,2) with the pins connected to
+ * the RTS (input of the module) and CTS (output of the module) lines
+ */
+bool SIM800L::enableFlowControl(uint8_t _pinRTS, uint8_t _pinCTS) {
+  sendCommand_P(AT_CMD_IFC, 2, 2);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : enableFlowControl() - Flow control refused by the module"));
+    return false;
+  }
+
+  pinRTS = _pinRTS;
+  pinCTS = _pinCTS;
+  pinMode(pinRTS, OUTPUT);
+  digitalWrite(pinRTS, LOW);
+  pinMode(pinCTS, INPUT);
+  receiveHeld = false;
+  flowControl = true;
+  return true;
+}
+
+/**
+ * Disable the hardware flow control (AT+IFC=0,0)
+ */
+bool SIM800L::disableFlowControl() {
+  sendCommand_P(AT_CMD_IFC, 0, 0);
+  flowControl = false;
+  return readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK);
+}
+
+/**
+ * Enable the slow clock mode controlled by the DTR pin (AT+CSCLK=1)
+ * The driver pulls DTR low to wake up the module before the commands and
+ * pulls it high to let the module sleep after idleMs without command
+ */
+bool SIM800L::enableSlowClock(uint8_t _pinDTR, uint16_t idleMs) {
+  pinDTR = _pinDTR;
+  pinMode(pinDTR, OUTPUT);
+  digitalWrite(pinDTR, LOW);
+  moduleAsleep = false;
+
+  sendCommand_P(AT_CMD_CSCLK1);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : enableSlowClock() - Slow clock refused by the module"));
+    return false;
+  }
+  slowClockMode = 1;
+  slowClockIdleMs = idleMs;
+  return true;
+}
+
+/**
+ * Enable the automatic slow clock mode (AT+CSCLK=2), the module sleeps by
+ * itself when the serial line is idle and is woken up by the serial line
+ */
+bool SIM800L::enableSlowClock() {
+  sendCommand_P(AT_CMD_CSCLK2);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : enableSlowClock() - Slow clock refused by the module"));
+    return false;
+  }
+  slowClockMode = 2;
+  return true;
+}
+
+/**
+ * Disable the slow clock mode (AT+CSCLK=0), the module is woken up first
+ */
+bool SIM800L::disableSlowClock() {
+  sendCommand_P(AT_CMD_CSCLK0);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    return false;
+  }
+  slowClockMode = 0;
+  return true;
+}
+
+/**
+ * Let the module sleep now in slow clock mode with DTR (DTR high)
+ */
+void SIM800L::enterSleep() {
+  if(slowClockMode != 1 || moduleAsleep) {
+    return;
+  }
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) debugStream->println(F("SIM800L : Sleep"));
+  digitalWrite(pinDTR, HIGH);
+  moduleAsleep = true;
+}
+
+/**
+ * Enable the compact mode: the module doesn't echo the commands (ATE0) and
+ * answers with numeric result codes (ATV0), 0 for OK and 4 for ERROR
+ */
+bool SIM800L::enableCompactMode() {
+  // The answer to this command may already be a numeric result code
+  compactMode = true;
+  sendCommand_P(AT_CMD_COMPACT);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : enableCompactMode() - Compact mode refused by the module"));
+    compactMode = false;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Disable the compact mode, back to the echo and verbose result codes (ATE1V1)
+ */
+bool SIM800L::disableCompactMode() {
+  sendCommand_P(AT_CMD_VERBOSE);
+  if(!readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK)) {
+    if(LOG_ENABLED(SIM800L_LOG_ERROR)) debugStream->println(F("SIM800L : disableCompactMode() - Verbose mode refused by the module"));
+    return false;
+  }
+  compactMode = false;
+  return true;
+}
+
+/**
+ * Define the power mode
+ * Available : MINIMUM, NORMAL, SLEEP
+ * Return true is the mode is correctly switched
+ */
+bool SIM800L::setPowerMode(PowerMode powerMode) {
+  // Check if the power mode requested is not ERROR or UNKNOWN
+  if(powerMode == POW_ERROR || powerMode == POW_UNKNOWN) {
+    return false;
+  }
+
+  // Check the current power mode
+  PowerMode currentPowerMode = getPowerMode();
+
+  // If the current power mode is undefined, abord
+  if(currentPowerMode == POW_ERROR || currentPowerMode == POW_UNKNOWN) {
+    return false;
+  }
+
+  // If the current power mode is the same that the requested power mode, say it's OK
+  if(currentPowerMode == powerMode) {
+    return true;
+  }
+
+  // If SLEEP or MINIMUM, only NORMAL is allowed
+  if((currentPowerMode == SLEEP || currentPowerMode == MINIMUM) && (powerMode != NORMAL)) {
+    return false;
+  }
+
+  // Send the command
+  switch(powerMode) {
+    case MINIMUM :
+      sendCommand_P(AT_CMD_CFUN0);
+      break;
+    case SLEEP :
+      sendCommand_P(AT_CMD_CFUN4);
+      break;
+    case NORMAL :
+    default :
+      sendCommand_P(AT_CMD_CFUN1);
+  }
+
+  // Read but don't care about the result
+  purgeSerial();
+  bearerStatus = BEARER_UNKNOWN;
+
+  // Check the current power mode
+  currentPowerMode = getPowerMode();
+
+  // If the current power mode is the same that the requested power mode, say it's OK
+  return currentPowerMode == powerMode;
+}
+
+/**
+ * Status function: Check the strengh of the signal
+ */
+uint8_t SIM800L::getSignal() {
+  char* value;
+  if(!queryStatus(QUERY_SIGNAL, &value) || value == NULL) {
+    return 0;
+  }
+
+  // Template : <rssi>,<ber> (99 if unknown)
+  uint8_t signal = atoi(value);
+  if(value[0] < '0' || value[0] > '9' || signal > 31) {
+    return 0;
+  }
+  return signal;
+}
+
+/*****************************************************************************************
+ * HELPERS
+ *****************************************************************************************/
+/**
+ * Find string "findStr" in another string "str"
+ * Returns the index of the first occurence, -1 elsewhere
+ */
+int16_t SIM800L::strIndex(const char* str, const char* findStr, uint16_t startIdx) {
+  if(str == NULL || findStr == NULL || startIdx > strlen(str)) {
+    return -1;
+  }
+  const char* found = strstr(str + startIdx, findStr);
+  if(found == NULL) {
+    return -1;
+  }
+  return found - str;
+}
+
+/**
+ * Keep a copy of a string to compare it exactly with the next value (false
+ * and empty copy if the string doesn't fit, it is then considered as changed)
+ */
+bool SIM800L::keepCopy(char* copy, uint8_t size, const char* str) {
+  if(strlen(str) >= size) {
+    copy[0] = '\0';
+    return false;
+  }
+  strcpy(copy, str);
+  return true;
+}
+
+/**
+ * Init internal buffer
+ * Only the first byte is cleared, the readers keep the buffer terminated by \0
+ */
+void SIM800L::initInternalBuffer() {
+  internalBuffer[0] = '\0';
+}
+
+/**
+ * Init recv buffer
+ * Only the first byte is cleared, the readers keep the buffer terminated by \0
+ */
+void SIM800L::initRecvBuffer() {
+  recvBuffer[0] = '\0';
+}
+
+/**
+ * Copy a string in the recv buffer (limited by the size of the buffer and
+ * terminated by \0)
+ */
+char* SIM800L::copyToRecvBuffer(const char* str, int16_t size) {
+  if(size < 0) {
+    size = 0;
+  }
+  if(size > recvBufferSize - 1) {
+    size = recvBufferSize - 1;
+  }
+  memcpy(recvBuffer, str, size);
+  recvBuffer[size] = '\0';
+  return getDataReceived();
+}
+
+/*****************************************************************************************
+ * LOW LEVEL FUNCTIONS TO COMMUNICATE WITH THE SIM800L MODULE
+ *****************************************************************************************/
+/**
+ * Send AT command to the module
+ */
+void SIM800L::sendCommand(const char* command) {
+  wakeModule();
+  metrics.commands++;
+  keepPendingCommand(command, false);
+
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
+    debugStream->print(F("SIM800L : Send \""));
+    debugStream->print(command);
+    debugStream->println(F("\""));
+  }
+
+  purgeSerial();
+  metrics.bytesSent += stream->write(command);
+  metrics.bytesSent += stream->write("\r\n");
+  purgeSerial();
+}
+
+/**
+ * Send AT command coming from the PROGMEM
+ * The command is written directly from the flash, without copy in RAM
+ */
+void SIM800L::sendCommand_P(const char* command) {
+  wakeModule();
+  metrics.commands++;
+  keepPendingCommand(command, true);
+
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
+    debugStream->print(F("SIM800L : Send \""));
+    debugStream->print((const __FlashStringHelper*)command);
+    debugStream->println(F("\""));
+  }
+
+  purgeSerial();
+  metrics.bytesSent += stream->print((const __FlashStringHelper*)command);
+  metrics.bytesSent += stream->write("\r\n");
+  purgeSerial();
+}
+
+/**
+ * Send AT command to the module with a parameter
+ */
+void SIM800L::sendCommand(const char* command, const char* parameter) {
+  wakeModule();
+  metrics.commands++;
+  keepPendingCommand(command, false);
+
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
+    debugStream->print(F("SIM800L : Send \""));
+    debugStream->print(command);
+    debugStream->print(F("\""));
+    debugStream->print(parameter);
+    debugStream->print(F("\""));
+    debugStream->println(F("\""));
+  }
+
+  purgeSerial();
+  metrics.bytesSent += stream->write(command);
+  metrics.bytesSent += stream->write("\"");
+  writeToModule((const uint8_t*)parameter, strlen(parameter));
+  metrics.bytesSent += stream->write("\"");
+  metrics.bytesSent += stream->write("\r\n");
+  purgeSerial();
+}
+
+/**
+ * Send AT command coming from the PROGMEM with a parameter
+ * The command is written directly from the flash, without copy in RAM
+ */
+void SIM800L::sendCommand_P(const char* command, const char* parameter) {
+  wakeModule();
+  metrics.commands++;
+  keepPendingCommand(command, true);
+
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
+    debugStream->print(F("SIM800L : Send \""));
+    debugStream->print((const __FlashStringHelper*)command);
+    debugStream->print(F("\""));
+    debugStream->print(parameter);
+    debugStream->print(F("\""));
+    debugStream->println(F("\""));
+  }
+
+  purgeSerial();
+  metrics.bytesSent += stream->print((const __FlashStringHelper*)command);
+  metrics.bytesSent += stream->write("\"");
+  writeToModule((const uint8_t*)parameter, strlen(parameter));
+  metrics.bytesSent += stream->write("\"");
+  metrics.bytesSent += stream->write("\r\n");
+  purgeSerial();
+}
+
+/**
+ * Send AT command coming from the PROGMEM with a numeric parameter
+ * (template : command<value>), formatted without any buffer
+ */
+void SIM800L::sendCommand_P(const char* command, uint32_t value) {
+  wakeModule();
+  metrics.commands++;
+  keepPendingCommand(command, true);
+
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
+    debugStream->print(F("SIM800L : Send \""));
+    debugStream->print((const __FlashStringHelper*)command);
+    debugStream->print(value);
+    debugStream->println(F("\""));
+  }
+
+  purgeSerial();
+  metrics.bytesSent += stream->print((const __FlashStringHelper*)command);
+  metrics.bytesSent += stream->print(value);
+  metrics.bytesSent += stream->write("\r\n");
+  purgeSerial();
+}
+
+/**
+ * Send AT command coming from the PROGMEM with two numeric parameters
+ * (template : command<value1>,<value2>), formatted without any buffer
+ */
+void SIM800L::sendCommand_P(const char* command, uint32_t value1, uint32_t value2) {
+  wakeModule();
+  metrics.commands++;
+  keepPendingCommand(command, true);
+
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
+    debugStream->print(F("SIM800L : Send \""));
+    debugStream->print((const __FlashStringHelper*)command);
+    debugStream->print(value1);
+    debugStream->print(',');
+    debugStream->print(value2);
+    debugStream->println(F("\""));
+  }
+
+  purgeSerial();
+  metrics.bytesSent += stream->print((const __FlashStringHelper*)command);
+  metrics.bytesSent += stream->print(value1);
+  metrics.bytesSent += stream->write(',');
+  metrics.bytesSent += stream->print(value2);
+  metrics.bytesSent += stream->write("\r\n");
+  purgeSerial();
+}
+
+/**
+ * Start to send an AT command coming from the PROGMEM, the parameters are
+ * appended with appendCommand() and the command is sent by endCommand()
+ */
+void SIM800L::beginCommand_P(const char* command) {
+  wakeModule();
+  metrics.commands++;
+  keepPendingCommand(command, true);
+
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
+    debugStream->print(F("SIM800L : Send \""));
+    debugStream->print((const __FlashStringHelper*)command);
+  }
+
+  purgeSerial();
+  metrics.bytesSent += stream->print((const __FlashStringHelper*)command);
+}
+
+/**
+ * Append a part of the command started with beginCommand_P() (written as is)
+ */
+void SIM800L::appendCommand(const char* part) {
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) debugStream->print(part);
+  writeToModule((const uint8_t*)part, strlen(part));
+}
+
+/**
+ * Append a numeric value to the command started with beginCommand_P()
+ */
+void SIM800L::appendCommand(uint32_t value) {
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) debugStream->print(value);
+  metrics.bytesSent += stream->print(value);
+}
+
+/**
+ * End and send the command started with beginCommand_P()
+ */
+void SIM800L::endCommand() {
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) debugStream->println(F("\""));
+
+  metrics.bytesSent += stream->write("\r\n");
+  purgeSerial();
+}
+
+/**
+ * Write data to the module; with the flow control, the data is written by
+ * small blocks only when the module is clear to send (CTS low)
+ * False if the module doesn't accept the data within the timeout
+ */
+bool SIM800L::writeToModule(const uint8_t* data, size_t size) {
+  if(!flowControl) {
+    metrics.bytesSent += stream->write(data, size);
+    return true;
+  }
+
+  uint32_t timerStart = millis();
+  while(size > 0) {
+    if(digitalRead(pinCTS) == HIGH) {
+      if(millis() - timerStart > DEFAULT_TIMEOUT) {
+        return false;
+      }
+      if(idleHook != NULL) {
+        idleHook(this);
+      }
+      continue;
+    }
+
+    size_t blockSize = size < FLOW_CONTROL_BLOCK_SIZE ? size : FLOW_CONTROL_BLOCK_SIZE;
+    metrics.bytesSent += stream->write(data, blockSize);
+    stream->flush();
+    data += blockSize;
+    size -= blockSize;
+    timerStart = millis();
+  }
+  return true;
+}
+
+/**
+ * With the flow control, ask the module to hold the transmission (RTS high)
+ * while the reception buffer of the host is almost full, and to resume once
+ * the driver has caught up
+ */
+void SIM800L::checkReceiveFlow() {
+  if(!flowControl) {
+    return;
+  }
+  bool hold = stream->available() >= FLOW_CONTROL_RX_HIGH;
+  if(hold != receiveHeld) {
+    digitalWrite(pinRTS, hold ? HIGH : LOW);
+    receiveHeld = hold;
+  }
+}
+
+/**
+ * Wake up the module in slow clock mode before a command
+ * With DTR, the pin is pulled low and the serial line is ready after a delay;
+ * without DTR, the first characters received by a sleeping module are lost,
+ * so a dummy AT wakes it up if the serial line has been idle
+ */
+void SIM800L::wakeModule() {
+  if(slowClockMode == 1 && moduleAsleep) {
+    if(LOG_ENABLED(SIM800L_LOG_DEBUG)) debugStream->println(F("SIM800L : Wake up"));
+    digitalWrite(pinDTR, LOW);
+    delay(SLOW_CLOCK_WAKE_DELAY);
+    moduleAsleep = false;
+  } else if(slowClockMode == 2 && millis() - lastCommandTime > SLOW_CLOCK_AUTO_SLEEP) {
+    if(LOG_ENABLED(SIM800L_LOG_DEBUG)) debugStream->println(F("SIM800L : Wake up"));
+    metrics.bytesSent += stream->write("AT\r\n");
+    delay(SLOW_CLOCK_WAKE_DELAY);
+    purgeSerial();
+  }
+  lastCommandTime = millis();
+}
+
+/**
+ * Let the module sleep in slow clock mode with DTR when no command has been
+ * sent during the idle delay and no HTTP request is ongoing
+ */
+void SIM800L::sleepIfIdle() {
+  if(slowClockMode != 1 || moduleAsleep) {
+    return;
+  }
+  if(httpState != HTTP_IDLE && httpState != HTTP_DONE) {
+    return;
+  }
+  if(millis() - lastCommandTime > slowClockIdleMs) {
+    enterSleep();
+  }
+}
+
+/**
+ * Purge the serial data
+ * The unsolicited messages are dispatched, everything else is dropped
+ */
+void SIM800L::purgeSerial() {
+  stream->flush();
+  processURC();
+  stream->flush();
 }
 
 /**
- * Status function: Check if AT command works
+ * Read the data available from the module line by line and dispatch the
+ * unsolicited messages (URC) without waiting
  */
-bool SIM800L::isReady() {
-  sendCommand_P(AT_CMD_BASE);
-  return readResponseCheckAnswer_P(DEFAULT_TIMEOUT, AT_RSP_OK);
+void SIM800L::processURC() {
+  while(stream->available()) {
+    char c = readFromModule();
+    // In compact mode, the numeric result codes are followed by CR only
+    if(c == '\n' || (compactMode && c == '\r')) {
+      urcBuffer[urcBufferLength] = '\0';
+      if(urcBufferLength > 0) {
+        dispatchURC(urcBuffer);
+      }
+      urcBufferLength = 0;
+    } else if(c != '\r' && urcBufferLength < URC_BUFFER_SIZE - 1) {
+      urcBuffer[urcBufferLength++] = c;
+    }
+  }
 }
 
 /**
- * Status function: Check the power mode
+ * Dispatch a line received from the module (without CR/LF) to the
+ * internal handlers and to the handlers registered for its prefix
  */
-PowerMode SIM800L::getPowerMode() {
-  sendCommand_P(AT_CMD_CFUN_TEST);
-  if(readResponse(DEFAULT_TIMEOUT)) {
-    // Check if there is an error
-    int16_t errIdx = strIndex(internalBuffer, "ERROR");
-    if(errIdx > 0) {
-      return POW_ERROR;
+void SIM800L::dispatchURC(const char* line) {
+  // Answer of the server on HTTP action (+HTTPACTION: <method>,<status>,<size>)
+  if(strncmp_P(line, AT_RSP_HTTPACTION, strlen_P(AT_RSP_HTTPACTION)) == 0) {
+    const char* value = line + strlen_P(AT_RSP_HTTPACTION);
+    httpActionMethod = atoi(value);
+    value = strchr(value, ',');
+    httpActionStatus = value != NULL ? atoi(value + 1) : 0;
+    value = value != NULL ? strchr(value + 1, ',') : NULL;
+    httpActionSize = value != NULL ? strtoul(value + 1, NULL, 10) : 0;
+    httpActionReceived = true;
+
+    // Network error or DNS error, the bearer may be lost
+    if(httpActionStatus == 601 || httpActionStatus == 603) {
+      bearerStatus = BEARER_UNKNOWN;
     }
+  }
+
+  // GPRS bearer closed by the network
+  if(strcmp_P(line, AT_RSP_SAPBR_DEACT) == 0) {
+    bearerStatus = BEARER_CLOSED;
+    bearerIP[0] = '\0';
+  }
 
-    // Extract the value
-    int16_t idx = strIndex(internalBuffer, "+CFUN: ");
-    char value = internalBuffer[idx + 7];
+  dispatchSocketURC(line);
 
-    // Prepare the clear output
-    switch(value) {
-      case '0' : return MINIMUM;
-      case '1' : return NORMAL;
-      case '4' : return SLEEP;
-      default  : return POW_UNKNOWN;
+  for(uint8_t i = 0; i < urcHandlerCount; i++) {
+    if(strncmp(line, urcPrefixes[i], strlen(urcPrefixes[i])) == 0) {
+      urcHandlers[i](this, line);
     }
   }
-  return POW_ERROR;
 }
 
 /**
- * Status function: Get version of the module
+ * Update the state of the sockets from the messages of the module
+ * In multi-connection mode, the messages start with the id of the
+ * connection (template : <id>, <message>)
  */
-char* SIM800L::getVersion() {
-  sendCommand_P(AT_CMD_ATI);
-  if(readResponse(DEFAULT_TIMEOUT)) {
-    // Extract the value
-    int16_t idx = strIndex(internalBuffer, "SIM");
-    int16_t idxEnd = strIndex(internalBuffer, "\r", idx+1);
+void SIM800L::dispatchSocketURC(const char* line) {
+  // Data received on a connection (+CIPRXGET: 1[,<id>])
+  if(strncmp_P(line, AT_RSP_CIPRXGET1, strlen_P(AT_RSP_CIPRXGET1)) == 0) {
+    const char* value = line + strlen_P(AT_RSP_CIPRXGET1);
+    uint8_t id = *value == ',' ? atoi(value + 1) : 0;
+    if(id < SOCKET_MAX_CONNECTIONS) {
+      socketDataFlags |= 1 << id;
+    }
+    return;
+  }
 
-    // Store it on the recv buffer (not used at the moment)
-    initRecvBuffer();
-    for(uint16_t i = 0; i < idxEnd - idx; i++) {
-      recvBuffer[i] = internalBuffer[idx + i];
+  // All the connections are lost with the IP context
+  if(strcmp_P(line, AT_RSP_PDP_DEACT) == 0) {
+    for(uint8_t i = 0; i < SOCKET_MAX_CONNECTIONS; i++) {
+      socketStates[i] = SOCKET_CLOSED;
     }
-    return getDataReceived();
-  } else {
-    return NULL;
+    socketSendStatus = -1;
+    return;
+  }
+
+  uint8_t id = 0;
+  if(line[0] >= '0' && line[0] <= '9' && line[1] == ',' && line[2] == ' ') {
+    id = line[0] - '0';
+    line += 3;
+  }
+  if(id >= SOCKET_MAX_CONNECTIONS) {
+    return;
+  }
+
+  if(strcmp_P(line, AT_RSP_CONNECT_OK) == 0 || strcmp_P(line, AT_RSP_ALREADY_CONNECT) == 0) {
+    socketStates[id] = SOCKET_CONNECTED;
+  } else if(strcmp_P(line, AT_RSP_CONNECT_FAIL) == 0) {
+    socketStates[id] = SOCKET_FAILED;
+  } else if(strcmp_P(line, AT_RSP_CLOSED) == 0 || strcmp_P(line, AT_RSP_CLOSE_OK) == 0) {
+    socketStates[id] = SOCKET_CLOSED;
+  } else if(strcmp_P(line, AT_RSP_SEND_OK) == 0) {
+    socketSendStatus = 1;
+  } else if(strcmp_P(line, AT_RSP_SEND_FAIL) == 0) {
+    socketSendStatus = -1;
   }
 }
 
 /**
- * Status function: Get firmware version
+ * Dispatch a line of the internal buffer (with CR/LF) as unsolicited message,
+ * unless it is the echo or an answer line of the pending command
  */
-char* SIM800L::getFirmware() {
-  sendCommand_P(AT_CMD_GMR);
-  if(readResponse(DEFAULT_TIMEOUT)) {
-    // Extract the value
-    int16_t idx = strIndex(internalBuffer, "AT+GMR") + 9;
-    int16_t idxEnd = strIndex(internalBuffer, "\r", idx+1);
-
-    // Store it on the recv buffer (not used at the moment)
-    initRecvBuffer();
-    for(uint16_t i = 0; i < idxEnd - idx; i++) {
-      recvBuffer[i] = internalBuffer[idx + i];
-    }
-    return getDataReceived();
-  } else {
-    return NULL;
+void SIM800L::dispatchURCLine(const char* line, uint16_t size) {
+  while(size > 0 && (line[size - 1] == '\r' || line[size - 1] == '\n')) {
+    size--;
   }
+  if(size == 0 || size >= URC_BUFFER_SIZE || isAnswerLine(line, size)) {
+    return;
+  }
+  memcpy(urcBuffer, line, size);
+  urcBuffer[size] = '\0';
+  dispatchURC(urcBuffer);
 }
 
 /**
- * Status function: Requests the simcard number
+ * Keep the start of the command sent (RAM or PROGMEM) until the next one
  */
-char* SIM800L::getSimCardNumber() {
-  sendCommand_P(AT_CMD_SIM_CARD);
-  if(readResponse(DEFAULT_TIMEOUT)) {
-    int16_t idx = strIndex(internalBuffer, "AT+CCID") + 10;
-    int16_t idxEnd = strIndex(internalBuffer, "\r", idx+1);
-
-    // Store it on the recv buffer (not used at the moment)
-    initRecvBuffer();
-    for(uint16_t i = 0; i < idxEnd - idx; i++) {
-      recvBuffer[i] = internalBuffer[idx + i];
-    }
-    return getDataReceived();
+void SIM800L::keepPendingCommand(const char* command, bool progmem) {
+  if(progmem) {
+    strncpy_P(pendingCommand, command, PENDING_COMMAND_SIZE - 1);
   } else {
-    return NULL;
+    strncpy(pendingCommand, command, PENDING_COMMAND_SIZE - 1);
   }
+  pendingCommand[PENDING_COMMAND_SIZE - 1] = '\0';
 }
 
 /**
- * Status function: Check if the module is registered on the network
+ * Check if a line received (without CR/LF) belongs to the pending command:
+ * its echo or an answer starting with the name of the command (i.e.
+ * "+CREG: 0,1" for AT+CREG?, each command of a chained command counts)
  */
-NetworkRegistration SIM800L::getRegistrationStatus() {
-  sendCommand_P(AT_CMD_CREG_TEST);
-  if(readResponse(DEFAULT_TIMEOUT)) {
-    // Check if there is an error
-    int16_t errIdx = strIndex(internalBuffer, "ERROR");
-    if(errIdx > 0) {
-      return NET_ERROR;
-    }
-
-    // Extract the value
-    int16_t idx = strIndex(internalBuffer, "+CREG: ");
-    char value = internalBuffer[idx + 9];
-
-    // Prepare the clear output
-    switch(value) {
-      case '0' : return NOT_REGISTERED;
-      case '1' : return REGISTERED_HOME;
-      case '2' : return SEARCHING;
-      case '3' : return DENIED;
-      case '5' : return REGISTERED_ROAMING;
-      default  : return NET_UNKNOWN;
+bool SIM800L::isAnswerLine(const char* line, uint16_t size) {
+  if(size >= 2 && line[0] == 'A' && line[1] == 'T') {
+    return true;
+  }
+  if(line[0] != '+') {
+    return false;
+  }
+  const char* colon = (const char*)memchr(line, ':', size);
+  if(colon == NULL) {
+    return false;
+  }
+  uint16_t nameSize = colon - line;
+  for(const char* name = strchr(pendingCommand, '+'); name != NULL; name = strchr(name + 1, '+')) {
+    // The name must end there in the command (AT+CIPRXGET=2 doesn't answer +CIPRX:)
+    if(strncmp(name, line, nameSize) == 0 && !isalnum(name[nameSize])) {
+      return true;
     }
   }
-
-  return NET_ERROR;
+  return false;
 }
 
 /**
- * Setup the GPRS connectivity
- * As input, give the APN string of the operator
+ * Register a handler for the unsolicited messages starting with a prefix
+ * (i.e. "RING", "+CMTI:", "UNDER-VOLTAGE"); the prefix must remain valid
+ * Return false if there is no more room for handlers
  */
-bool SIM800L::setupGPRS(const char* apn) {
-  // Prepare the GPRS connection as the bearer
-  sendCommand_P(AT_CMD_SAPBR_GPRS);
-  if(!readResponseCheckAnswer_P(20000, AT_RSP_OK)) {
+bool SIM800L::addURCHandler(const char* prefix, URCHandler handler) {
+  if(urcHandlerCount >= URC_MAX_HANDLERS) {
     return false;
   }
-
-  // Set the config of the bearer with the APN
-  sendCommand_P(AT_CMD_SAPBR_APN, apn);
-  return readResponseCheckAnswer_P(20000, AT_RSP_OK);
+  urcPrefixes[urcHandlerCount] = prefix;
+  urcHandlers[urcHandlerCount] = handler;
+  urcHandlerCount++;
+  return true;
 }
 
 /**
- * Open the GPRS connectivity
+ * Read from module and expect a specific answer (timeout in millisec)
+ * The reading stops at the end of the line starting with the expected answer
+ * or with ERROR, +CME ERROR or +CMS ERROR
  */
-bool SIM800L::connectGPRS() {
-  sendCommand_P(AT_CMD_SAPBR1);
-  // Timout is max 85 seconds according to SIM800 specifications
-  // We will wait for 65s to be within uint16_t
-  return readResponseCheckAnswer_P(65000, AT_RSP_OK);
+bool SIM800L::readResponseCheckAnswer_P(uint16_t timeout, const char* expectedAnswer) {
+  return readResponse(timeout, 0, expectedAnswer);
 }
 
 /**
- * Close the GPRS connectivity
+ * Reset the incremental matcher of the answer
  */
-bool SIM800L::disconnectGPRS() {
-  sendCommand_P(AT_CMD_SAPBR0);
-  // Timout is max 65 seconds according to SIM800 specifications
-  return readResponseCheckAnswer_P(65000, AT_RSP_OK);
+void SIM800L::startMatchAnswer(const char* expectedAnswer) {
+  matchAnswer = expectedAnswer;
+  matchAnswerPos = 0;
+  matchErrorPos = 0;
+  matchCMErrorPos = 0;
+  matchCodePos = 0;
 }
 
 /**
- * Define the power mode
- * Available : MINIMUM, NORMAL, SLEEP
- * Return true is the mode is correctly switched
+ * Incremental matcher of the answer, fed with each char received
+ * Only the start of the lines is compared to the expected answer (PROGMEM) and
+ * to ERROR, +CME ERROR and +CMS ERROR, so the echo of the command can't match
+ * (the prompts starting with '>' match as soon as they are received). In
+ * compact mode, a line with only the numeric result code (followed by CR)
+ * matches OK or ERROR (4)
+ * Return 1 at the end of the line with the expected answer, -1 at the end of a
+ * line with an error, 0 elsewhere
  */
-bool SIM800L::setPowerMode(PowerMode powerMode) {
-  // Check if the power mode requested is not ERROR or UNKNOWN
-  if(powerMode == POW_ERROR || powerMode == POW_UNKNOWN) {
-    return false;
-  }
-
-  // Check the current power mode
-  PowerMode currentPowerMode = getPowerMode();
-
-  // If the current power mode is undefined, abord
-  if(currentPowerMode == POW_ERROR || currentPowerMode == POW_UNKNOWN) {
-    return false;
-  }
-
-  // If the current power mode is the same that the requested power mode, say it's OK
-  if(currentPowerMode == powerMode) {
-    return true;
+int8_t SIM800L::matchAnswerChar(char c) {
+  if(c == '\n') {
+    int8_t result = 0;
+    if(matchAnswerPos > 0 && pgm_read_byte(matchAnswer + matchAnswerPos) == '\0') {
+      result = 1;
+    } else if((matchErrorPos > 0 && pgm_read_byte(AT_RSP_ERROR + matchErrorPos) == '\0') ||
+              (matchCMErrorPos > 0 && pgm_read_byte(AT_RSP_CM_ERROR + matchCMErrorPos) == '\0')) {
+      result = -1;
+    }
+    matchAnswerPos = 0;
+    matchErrorPos = 0;
+    matchCMErrorPos = 0;
+    matchCodePos = 0;
+    return result;
   }
 
-  // If SLEEP or MINIMUM, only NORMAL is allowed
-  if((currentPowerMode == SLEEP || currentPowerMode == MINIMUM) && (powerMode != NORMAL)) {
-    return false;
+  if(c == '\r') {
+    // Numeric result code, the next line starts without LF
+    if(compactMode && matchCodePos == 1) {
+      matchAnswerPos = 0;
+      matchErrorPos = 0;
+      matchCMErrorPos = 0;
+      matchCodePos = 0;
+      if(matchCode == pgm_read_byte(AT_RSP_OK_CODE) && matchAnswer == AT_RSP_OK) {
+        return 1;
+      } else if(matchCode == pgm_read_byte(AT_RSP_ERROR_CODE)) {
+        return -1;
+      }
+    }
+    // A code may follow without LF (i.e. after the echo of the command)
+    matchCodePos = 0;
+    return 0;
   }
 
-  // Send the command
-  char value;
-  switch(powerMode) {
-    case MINIMUM :
-      sendCommand_P(AT_CMD_CFUN0);
-      break;
-    case SLEEP :
-      sendCommand_P(AT_CMD_CFUN4);
-      break;
-    case NORMAL :
-    default :
-      sendCommand_P(AT_CMD_CFUN1);
+  // A numeric result code is a line with one digit
+  if(matchCodePos == 0 && c >= '0' && c <= '9') {
+    matchCode = c;
+    matchCodePos = 1;
+  } else {
+    matchCodePos = -1;
   }
 
-  // Read but don't care about the result
-  purgeSerial();
-
-  // Check the current power mode
-  currentPowerMode = getPowerMode();
-
-  // If the current power mode is the same that the requested power mode, say it's OK
-  return currentPowerMode == powerMode;
-}
-
-/**
- * Status function: Check the strengh of the signal
- */
-uint8_t SIM800L::getSignal() {
-  sendCommand_P(AT_CMD_CSQ);
-  if(readResponse(DEFAULT_TIMEOUT)) {
-    int16_t idxBase = strIndex(internalBuffer, "AT+CSQ");
-    if(idxBase != 0) {
-      return 0;
+  // Progress on the expected answer until a mismatch on the line
+  if(matchAnswerPos >= 0) {
+    char expected = pgm_read_byte(matchAnswer + matchAnswerPos);
+    if(expected == c) {
+      matchAnswerPos++;
+      // The prompts to send data are not followed by CR/LF
+      if(pgm_read_byte(matchAnswer) == '>' && pgm_read_byte(matchAnswer + matchAnswerPos) == '\0') {
+        matchAnswerPos = 0;
+        return 1;
+      }
+    } else if(expected != '\0') {
+      matchAnswerPos = -1;
     }
-    int16_t idxEnd = strIndex(internalBuffer, ",", idxBase);
-    uint8_t value = internalBuffer[idxEnd - 1] - '0';
-    if(internalBuffer[idxEnd - 2] != ' ') {
-      value += (internalBuffer[idxEnd - 2] - '0') * 10;
+  }
+  if(matchErrorPos >= 0) {
+    char expected = pgm_read_byte(AT_RSP_ERROR + matchErrorPos);
+    if(expected == c) {
+      matchErrorPos++;
+    } else if(expected != '\0') {
+      matchErrorPos = -1;
     }
-    if(value > 31) {
-      return 0;
+  }
+  if(matchCMErrorPos >= 0) {
+    // +CME ERROR or +CMS ERROR
+    char expected = pgm_read_byte(AT_RSP_CM_ERROR + matchCMErrorPos);
+    if(expected == c || (matchCMErrorPos == 3 && c == 'S')) {
+      matchCMErrorPos++;
+    } else if(expected != '\0') {
+      matchCMErrorPos = -1;
     }
-    return value;
   }
   return 0;
 }
 
-/*****************************************************************************************
- * HELPERS
- *****************************************************************************************/
 /**
- * Find string "findStr" in another string "str"
- * Returns true if found, false elsewhere
+ * Read exactly a number of bytes from the module into a buffer
+ * (the bytes are dropped if the buffer is NULL)
+ * False if the bytes are not received within the timeout
  */
-int16_t SIM800L::strIndex(const char* str, const char* findStr, uint16_t startIdx) {
-  int16_t firstIndex = -1;
-  int16_t sizeMatch = 0;
-  for(int16_t i = startIdx; i < strlen(str); i++) {
-    if(sizeMatch >= strlen(findStr)) {
-      break;
+bool SIM800L::readRawData(char* buffer, uint16_t size) {
+  uint32_t timerStart = millis();
+  for(uint16_t i = 0; i < size; i++) {
+    if(!waitData(timerStart, DEFAULT_TIMEOUT)) {
+      return false;
     }
-    if(str[i] == findStr[sizeMatch]) {
-      if(firstIndex < 0) {
-        firstIndex = i;
-      }
-      sizeMatch++;
-    } else {
-      firstIndex = -1;
-      sizeMatch = 0;
+    char c = readFromModule();
+    if(buffer != NULL) {
+      buffer[i] = c;
     }
+    timerStart = millis();
   }
-
-  if(sizeMatch >= strlen(findStr)) {
-    return firstIndex;
-  } else {
-    return -1;
-  }
+  return true;
 }
 
 /**
- * Init internal buffer
+ * Read a byte from the module (hold the module with the flow control if the
+ * reception buffer is almost full)
  */
-void SIM800L::initInternalBuffer() {
-  for(uint16_t i = 0; i < internalBufferSize; i++) {
-    internalBuffer[i] = '\0';
-  }
+char SIM800L::readFromModule() {
+  char c = stream->read();
+  checkReceiveFlow();
+  metrics.bytesReceived++;
+  return c;
 }
 
 /**
- * Init recv buffer
+ * Wait until data is available from the module, calling the idle hook
+ * while waiting
+ * False if nothing is received before the deadline (timerStart + timeout)
  */
-void SIM800L::initRecvBuffer() {
-  // Cleanup the receive buffer
-  for(uint16_t i = 0; i < recvBufferSize; i++) {
-    recvBuffer[i] = 0;
+bool SIM800L::waitData(uint32_t timerStart, uint16_t timeout) {
+  while(!stream->available()) {
+    if(millis() - timerStart > timeout) {
+      metrics.timeouts++;
+      return false;
+    }
+    if(idleHook != NULL) {
+      idleHook(this);
+    }
+    flushLog();
   }
+  return true;
 }
 
-/*****************************************************************************************
- * LOW LEVEL FUNCTIONS TO COMMUNICATE WITH THE SIM800L MODULE
- *****************************************************************************************/
 /**
- * Send AT command to the module
+ * Define the function called while the driver is waiting for the module
+ * (i.e. to feed a watchdog); the hook must not use the driver
  */
-void SIM800L::sendCommand(const char* command) {
-  if(enableDebug) {
-    debugStream->print(F("SIM800L : Send \""));
-    debugStream->print(command);
-    debugStream->println(F("\""));
-  }
+void SIM800L::setIdleHook(IdleHook hook) {
+  idleHook = hook;
+}
 
-  purgeSerial();
-  stream->write(command);
-  stream->write("\r\n");
-  purgeSerial();
+/**
+ * Return the metrics of the driver since the start or the last reset
+ * (counters and durations of the phases, collected even without debug)
+ */
+const DriverMetrics* SIM800L::getMetrics() {
+  return &metrics;
 }
 
 /**
- * Send AT command coming from the PROGMEM
+ * Reset all the metrics of the driver
  */
-void SIM800L::sendCommand_P(const char* command) {
-  char cmdBuff[32];
-  strcpy_P(cmdBuff, command);
-  sendCommand(cmdBuff);
+void SIM800L::resetMetrics() {
+  memset(&metrics, 0, sizeof(metrics));
 }
 
 /**
- * Send AT command to the module with a parameter
+ * Queue the debug messages in a ring buffer instead of writing them to the
+ * console, the buffer is emptied by poll() and while waiting for the module
+ * (the messages are dropped if the buffer is full)
+ * Nothing is written while the console reports no room in its transmit
+ * buffer, unless writeBlocks is true (console without availableForWrite())
+ * False if the debug is not enabled
  */
-void SIM800L::sendCommand(const char* command, const char* parameter) {
-  if(enableDebug) {
-    debugStream->print(F("SIM800L : Send \""));
-    debugStream->print(command);
-    debugStream->print(F("\""));
-    debugStream->print(parameter);
-    debugStream->print(F("\""));
-    debugStream->println(F("\""));
+bool SIM800L::enableAsyncLog(char* buffer, uint16_t size, bool writeBlocks) {
+  if(!enableDebug || buffer == NULL || size < 2) {
+    return false;
   }
-
-  purgeSerial();
-  stream->write(command);
-  stream->write("\"");
-  stream->write(parameter);
-  stream->write("\"");
-  stream->write("\r\n");
-  purgeSerial();
+  if(asyncLog) {
+    disableAsyncLog();
+  }
+  logBuffer.begin(buffer, size, debugStream, writeBlocks);
+  debugStream = &logBuffer;
+  asyncLog = true;
+  return true;
 }
 
 /**
- * Send AT command coming from the PROGMEM with a parameter
+ * Write all the queued debug messages and go back to the console
  */
-void SIM800L::sendCommand_P(const char* command, const char* parameter) {
-  char cmdBuff[32];
-  strcpy_P(cmdBuff, command);
-  sendCommand(cmdBuff, parameter);
+void SIM800L::disableAsyncLog() {
+  if(!asyncLog) {
+    return;
+  }
+  logBuffer.flushOutput(true);
+  debugStream = logBuffer.getOutput();
+  asyncLog = false;
 }
 
 /**
- * Purge the serial data
+ * Write the queued debug messages accepted by the console without blocking
  */
-void SIM800L::purgeSerial() {
-  stream->flush();
-  while (stream->available()) {
-    stream->read();
+void SIM800L::flushLog() {
+  if(asyncLog) {
+    logBuffer.flushOutput(false);
   }
-  stream->flush();
 }
 
 /**
- * Read from module and expect a specific answer (timeout in millisec)
+ * Number of bytes of debug messages dropped since the async log is enabled
  */
-bool SIM800L::readResponseCheckAnswer_P(uint16_t timeout, const char* expectedAnswer, uint8_t crlfToWait) {
-  if(readResponse(timeout, crlfToWait)) {
-    // Prepare the local expected answer
-    char rspBuff[16];
-    strcpy_P(rspBuff, expectedAnswer);
+uint32_t SIM800L::getLogDropped() {
+  return asyncLog ? logBuffer.getDropped() : 0;
+}
 
-    // Check if it's the expected answer
-    int16_t idx = strIndex(internalBuffer, rspBuff);
-    if(idx > 0) {
-      return true;
-    }
+/**
+ * Add the duration of a phase started at timerStart to the metrics
+ */
+void SIM800L::recordPhase(MetricsPhase phase, uint32_t timerStart) {
+  uint32_t duration = millis() - timerStart;
+  uint16_t durationMs = duration > 0xFFFF ? 0xFFFF : duration;
+  PhaseMetrics* phaseMetrics = &metrics.phases[phase];
+  if(phaseMetrics->count == 0 || durationMs < phaseMetrics->minMs) {
+    phaseMetrics->minMs = durationMs;
   }
-  return false;
+  if(durationMs > phaseMetrics->maxMs) {
+    phaseMetrics->maxMs = durationMs;
+  }
+  phaseMetrics->totalMs += duration;
+  phaseMetrics->count++;
 }
 
 /**
- * Read from the module for a specific number of CRLF
- * True if we have some data
+ * Read from the module for a specific number of CRLF or, if an expected
+ * answer is given (PROGMEM), until the end of the line with this answer
+ * True if we have some data (or the expected answer)
  */
-bool SIM800L::readResponse(uint16_t timeout, uint8_t crlfToWait) {
+bool SIM800L::readResponse(uint16_t timeout, uint8_t crlfToWait, const char* expectedAnswer) {
   uint16_t currentSizeResponse = 0;
   bool seenCR = false;
   uint8_t countCRLF = 0;
 
   // First of all, cleanup the buffer
   initInternalBuffer();
+  if(expectedAnswer != NULL) {
+    startMatchAnswer(expectedAnswer);
+  }
+  uint16_t lineStart = 0;
+  urcBufferLength = 0;
 
   uint32_t timerStart = millis();
 
@@ -892,40 +3471,78 @@ bool SIM800L::readResponse(uint16_t timeout, uint8_t crlfToWait) {
     // While there is data available on the buffer, read it until the max size of the response
     if(stream->available()) {
       // Load the next char
-      internalBuffer[currentSizeResponse] = stream->read();
-
-      // Detect end of transmission (CRLF)
-      if(internalBuffer[currentSizeResponse] == '\r') {
-        seenCR = true;
-      } else if (internalBuffer[currentSizeResponse] == '\n' && seenCR) {
-        countCRLF++;
-        if(countCRLF == crlfToWait) {
-          if(enableDebug) debugStream->println(F("SIM800L : End of transmission"));
-          break;
+      char c = readFromModule();
+
+      if(expectedAnswer != NULL) {
+        // Keep the last byte of the buffer for the final \0 and drop the
+        // overflow while looking for the expected answer
+        if(currentSizeResponse < internalBufferSize - 1) {
+          internalBuffer[currentSizeResponse++] = c;
+          internalBuffer[currentSizeResponse] = '\0';
+        }
+
+        int8_t match = matchAnswerChar(c);
+        if(match != 0) {
+          if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
+            debugStream->print(F("SIM800L : Receive \""));
+            debugStream->print(internalBuffer);
+            debugStream->println(F("\""));
+          }
+          if(match < 0) {
+            metrics.errors++;
+          }
+          return match > 0;
+        }
+
+        // Other lines may be unsolicited messages received in the middle of the answer
+        if(c == '\n' || (compactMode && c == '\r')) {
+          dispatchURCLine(internalBuffer + lineStart, currentSizeResponse - lineStart);
+          lineStart = currentSizeResponse;
         }
       } else {
-        seenCR = false;
-      }
+        if(currentSizeResponse + 1 < internalBufferSize) {
+          internalBuffer[currentSizeResponse] = c;
+          internalBuffer[currentSizeResponse + 1] = '\0';
+        }
+
+        // Detect end of transmission (CRLF)
+        if(c == '\r') {
+          seenCR = true;
+        } else if (c == '\n' && seenCR) {
+          // Unsolicited messages received in the middle of the answer
+          if(currentSizeResponse + 1 < internalBufferSize) {
+            dispatchURCLine(internalBuffer + lineStart, currentSizeResponse + 1 - lineStart);
+          }
+          lineStart = currentSizeResponse + 1;
+          countCRLF++;
+          if(countCRLF == crlfToWait) {
+            if(LOG_ENABLED(SIM800L_LOG_DEBUG)) debugStream->println(F("SIM800L : End of transmission"));
+            break;
+          }
+        } else {
+          seenCR = false;
+        }
 
-      // Prepare for next read
-      currentSizeResponse++;
+        // Prepare for next read
+        currentSizeResponse++;
 
-      // Avoid buffer overflow
-      if(currentSizeResponse == internalBufferSize) {
-        if(enableDebug) debugStream->println(F("SIM800L : Received maximum buffer size"));
-        break;
+        // Avoid buffer overflow
+        if(currentSizeResponse + 1 >= internalBufferSize) {
+          if(LOG_ENABLED(SIM800L_LOG_DEBUG)) debugStream->println(F("SIM800L : Received maximum buffer size"));
+          break;
+        }
       }
     }
 
     // If timeout, abord the reading
-    if(millis() - timerStart > timeout) {
-      if(enableDebug) debugStream->println(F("SIM800L : Receive timeout"));
+    if(!waitData(timerStart, timeout)) {
+      if(LOG_ENABLED(SIM800L_LOG_DEBUG)) debugStream->println(F("SIM800L : Receive timeout"));
       // Timeout, return false to parent function
       return false;
     }
   }
 
-  if(enableDebug) {
+  if(LOG_ENABLED(SIM800L_LOG_DEBUG)) {
     debugStream->print(F("SIM800L : Receive \""));
     debugStream->print(internalBuffer);
     debugStream->println(F("\""));
@@ -934,3 +3551,98 @@ bool SIM800L::readResponse(uint16_t timeout, uint8_t crlfToWait) {
   // If we are here, it's OK ;-)
   return true;
 }
+
+/**
+ * Use the buffer as ring buffer for the messages to the output
+ */
+void SIM800LLogBuffer::begin(char* _buffer, uint16_t _size, Stream* _output, bool _writeBlocks) {
+  buffer = _buffer;
+  size = _size;
+  head = 0;
+  tail = 0;
+  dropped = 0;
+  output = _output;
+  writeBlocks = _writeBlocks;
+}
+
+/**
+ * Return the console receiving the messages
+ */
+Stream* SIM800LLogBuffer::getOutput() {
+  return output;
+}
+
+/**
+ * Write the queued bytes to the output, limited to the room in the transmit
+ * buffer of the output unless all is true (nothing if the output is full, or
+ * a small block if writeBlocks is set because the room is unknown)
+ */
+void SIM800LLogBuffer::flushOutput(bool all) {
+  if(output == NULL) {
+    return;
+  }
+  int room = output->availableForWrite();
+  if(room <= 0) {
+    room = writeBlocks ? LOG_FLUSH_BLOCK_SIZE : 0;
+  }
+  while(head != tail && (all || room > 0)) {
+    // Contiguous bytes until the end of the buffer or the head
+    uint16_t count = (head > tail ? head : size) - tail;
+    if(!all && count > room) {
+      count = room;
+    }
+    output->write((const uint8_t*)&buffer[tail], count);
+    tail = (tail + count) % size;
+    room -= count;
+  }
+}
+
+/**
+ * Number of bytes dropped because the buffer was full
+ */
+uint32_t SIM800LLogBuffer::getDropped() {
+  return dropped;
+}
+
+/**
+ * Queue a byte, dropped if the buffer is full
+ */
+size_t SIM800LLogBuffer::write(uint8_t c) {
+  uint16_t next = (head + 1) % size;
+  if(buffer == NULL || next == tail) {
+    dropped++;
+    return 0;
+  }
+  buffer[head] = c;
+  head = next;
+  return 1;
+}
+
+/**
+ * Number of bytes queued
+ */
+int SIM800LLogBuffer::available() {
+  return head >= tail ? head - tail : size - tail + head;
+}
+
+/**
+ * Read the oldest byte queued (-1 if empty)
+ */
+int SIM800LLogBuffer::read() {
+  if(head == tail) {
+    return -1;
+  }
+  uint8_t c = buffer[tail];
+  tail = (tail + 1) % size;
+  return c;
+}
+
+/**
+ * Oldest byte queued without removing it (-1 if empty)
+ */
+int SIM800LLogBuffer::peek() {
+  if(head == tail) {
+    return -1;
+  }
+  return (uint8_t)buffer[tail];
+}
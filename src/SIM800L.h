@@ -35,9 +35,130 @@
 
 #define DEFAULT_TIMEOUT 5000
 #define RESET_PIN_NOT_USED -1
+#define URC_BUFFER_SIZE 48
+#define URC_MAX_HANDLERS 4
+#define PENDING_COMMAND_SIZE 24
+#define FLOW_CONTROL_RX_HIGH 48
+#define FLOW_CONTROL_BLOCK_SIZE 16
+#define SLOW_CLOCK_WAKE_DELAY 100
+#define SLOW_CLOCK_AUTO_SLEEP 5000
+#define SOCKET_MAX_CONNECTIONS 6
+#define SOCKET_MAX_READ 1460
+#define HTTP_METHOD_GET 0
+#define HTTP_METHOD_POST 1
+#define HTTP_METHOD_HEAD 2
+#define HTTP_PARAM_COPY_SIZE 48
+#define STORED_FILE_NAME_SIZE 32
+#define LOG_FLUSH_BLOCK_SIZE 8
+
+// Level of the debug messages compiled in the driver, the messages above the level are removed from the binary
+// (0 : none, 1 : errors, 2 : infos, 3 : exchanges with the module)
+#ifndef SIM800L_LOG_LEVEL
+#define SIM800L_LOG_LEVEL 3
+#endif
+#define SIM800L_LOG_ERROR 1
+#define SIM800L_LOG_INFO 2
+#define SIM800L_LOG_DEBUG 3
 
 enum PowerMode {MINIMUM, NORMAL, POW_UNKNOWN, SLEEP, POW_ERROR};
 enum NetworkRegistration {NOT_REGISTERED, REGISTERED_HOME, SEARCHING, DENIED, NET_UNKNOWN, REGISTERED_ROAMING, NET_ERROR};
+enum HTTPState {HTTP_IDLE, HTTP_INIT, HTTP_CONTENT_TYPE, HTTP_UPLOAD, HTTP_ACTION, HTTP_WAIT_RESPONSE, HTTP_HEADERS, HTTP_READ, HTTP_TERM, HTTP_DONE};
+enum SSLOption {SSL_IGNORE_INVALID_CERTIFICATE, SSL_CLIENT_AUTHENTICATION};
+enum BearerStatus {BEARER_CONNECTING, BEARER_CONNECTED, BEARER_CLOSING, BEARER_CLOSED, BEARER_UNKNOWN};
+enum SocketProtocol {SOCKET_TCP, SOCKET_UDP};
+enum SocketState {SOCKET_CLOSED, SOCKET_CONNECTING, SOCKET_CONNECTED, SOCKET_FAILED};
+enum MetricsPhase {METRICS_HTTP_INIT, METRICS_HTTP_UPLOAD, METRICS_HTTP_ACTION, METRICS_HTTP_READ, METRICS_HTTP_TERM, METRICS_GPRS_CONNECT, METRICS_PHASES};
+
+class SIM800L;
+
+// Request waiting in the HTTP queue (POST if the content type is defined, GET otherwise)
+// The strings must remain valid until the request is sent
+struct HTTPRequest {
+  const char* url;
+  const char* headers;
+  const char* contentType;
+  const char* payload;
+  uint16_t clientWriteTimeoutMs;
+  uint16_t serverReadTimeoutMs;
+};
+
+// Readiness of the network obtained in one exchange with the module
+struct NetworkSnapshot {
+  bool valid;                        // False if the module didn't answer all the fields
+  NetworkRegistration registration;  // Network registration (+CREG)
+  uint8_t signal;                    // Signal strength 0-31 (0 if unknown)
+  bool attached;                     // GPRS service attached (+CGATT)
+  bool ready;                        // Registered, with signal and attached
+};
+
+// Durations of a phase in millisec (average = totalMs / count)
+struct PhaseMetrics {
+  uint16_t count;
+  uint16_t minMs;
+  uint16_t maxMs;
+  uint32_t totalMs;
+};
+
+// Metrics of the driver since the start or the last reset
+struct DriverMetrics {
+  PhaseMetrics phases[METRICS_PHASES];  // Indexed by MetricsPhase
+  uint32_t commands;                    // AT commands sent
+  uint32_t bytesSent;                   // Bytes written to the module (commands and data)
+  uint32_t bytesReceived;               // Bytes read from the module
+  uint16_t errors;                      // ERROR answers of the module
+  uint16_t timeouts;                    // Readings without data within the timeout
+  uint16_t retries;                     // Transfers resumed by the driver (downloads, stored records)
+  uint16_t httpRequests;                // HTTP requests finished
+  uint16_t httpFailures;                // HTTP requests failed with an error code of the driver
+};
+
+// Callback at the end of an asynchronous HTTP request (HTTP status code or error code of the driver)
+typedef void (*HTTPCallback)(SIM800L* sim800l, uint16_t httpRC);
+
+// Callback at the end of each request of the HTTP queue (HTTP status code or error code of the driver)
+typedef void (*HTTPQueueCallback)(SIM800L* sim800l, const HTTPRequest* request, uint16_t httpRC);
+
+// Function switching the serial line of the host to a baud rate (i.e. calling Serial1.begin(baudRate))
+typedef void (*BaudRateSetter)(uint32_t baudRate);
+
+// Function called while the driver is waiting for the module (i.e. to feed a watchdog)
+typedef void (*IdleHook)(SIM800L* sim800l);
+
+// Handler of an unsolicited message received from the module (line without CR/LF)
+typedef void (*URCHandler)(SIM800L* sim800l, const char* urc);
+
+// Callback producing the payload of a POST by blocks (at most size bytes at the offset, return the number of bytes written in buffer)
+typedef uint16_t (*HTTPPayloadCallback)(SIM800L* sim800l, char* buffer, uint16_t size, uint32_t offset);
+
+// Callback receiving the data of an HTTP response by chunks (offset of the chunk in the response)
+typedef void (*HTTPDataCallback)(SIM800L* sim800l, const char* data, uint16_t size, uint32_t offset);
+
+// Ring buffer collecting the debug messages, emptied to the console without blocking by flushOutput()
+// The bytes written when the buffer is full are dropped and counted
+class SIM800LLogBuffer : public Stream {
+  public:
+    // writeBlocks : write LOG_FLUSH_BLOCK_SIZE bytes when the output reports no room (availableForWrite() not implemented)
+    void begin(char* _buffer, uint16_t _size, Stream* _output, bool _writeBlocks = false);
+    Stream* getOutput();
+    // Write to the output what it accepts without blocking (all the content if all is true)
+    void flushOutput(bool all);
+    uint32_t getDropped();
+
+    size_t write(uint8_t c);
+    using Print::write;
+    int available();
+    int read();
+    int peek();
+
+  private:
+    char* buffer = NULL;
+    uint16_t size = 0;
+    uint16_t head = 0;
+    uint16_t tail = 0;
+    uint32_t dropped = 0;
+    Stream* output = NULL;
+    bool writeBlocks = false;
+};
 
 class SIM800L {
   public:
@@ -50,6 +171,14 @@ class SIM800L {
     //  _recvBufferSize (optional) : size in bytes of the reception buffer (max data to receive from GET or POST)
     //  _debugStream (optional) : Stream opened to the debug console (Software of Hardware)
     SIM800L(Stream* _stream, uint8_t _pinRst = RESET_PIN_NOT_USED, uint16_t _internalBufferSize = 128, uint16_t _recvBufferSize = 256, Stream* _debugStream = NULL);
+    // Initialize the driver with buffers provided by the caller (no dynamic allocation)
+    // Parameters:
+    //  _stream : Stream opened to the SIM800L module (Software or Hardware, usually 9600 bps)
+    //  _pinRst : pin to the reset of the SIM800L module (or RESET_PIN_NOT_USED)
+    //  _internalBuffer, _internalBufferSize : buffer to handle general IO with the module and its size in bytes
+    //  _recvBuffer, _recvBufferSize : reception buffer and its size in bytes
+    //  _debugStream (optional) : Stream opened to the debug console (Software of Hardware)
+    SIM800L(Stream* _stream, uint8_t _pinRst, char* _internalBuffer, uint16_t _internalBufferSize, char* _recvBuffer, uint16_t _recvBufferSize, Stream* _debugStream = NULL);
     ~SIM800L();
 
     // Force a reset of the module
@@ -60,10 +189,54 @@ class SIM800L {
     uint8_t getSignal();
     PowerMode getPowerMode();
     NetworkRegistration getRegistrationStatus();
+    // Registration, signal and GPRS attachment with a single chained command
+    NetworkSnapshot getNetworkSnapshot();
     char* getVersion();
     char* getFirmware();
     char* getSimCardNumber();
 
+    // Capabilities of the module (probed once and cached)
+    bool isSSLSupported();
+    uint8_t getFirmwareRelease();
+    const char* getModel();
+
+    // SSL options of the module for HTTPS (firmware R14 and above), kept by the module between the sessions
+    bool setSSLOption(SSLOption option, bool enable);
+    // Write a certificate in the file system of the module (C:\USER\<fileName>) and use it for SSL
+    bool loadCertificate(const char* fileName, const uint8_t* data, uint16_t size);
+    bool setSSLCertificate(const char* fileName, const char* password = NULL);
+
+    // Store-and-forward: records (text lines) appended to a file of the module (C:\USER\<fileName>) while offline,
+    // then posted by parts of whole records in one HTTP session; the file is deleted once all the parts are accepted
+    bool storeRecord(const char* fileName, const char* record);
+    uint32_t getStoredSize(const char* fileName);
+    uint16_t postStored(const char* url, const char* headers, const char* contentType, const char* fileName, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs);
+    bool deleteStored(const char* fileName);
+
+    // Baud rate of the serial line (the host side is switched by the function given)
+    bool setBaudRate(uint32_t baudRate, BaudRateSetter setHostBaudRate);
+    uint32_t negotiateBaudRate(BaudRateSetter setHostBaudRate, uint32_t maxBaudRate = 115200);
+    uint32_t detectBaudRate(BaudRateSetter setHostBaudRate);
+    uint32_t getBaudRate();
+
+    // Hardware flow control (RTS/CTS) for large transfers at high baud rates
+    bool enableFlowControl(uint8_t pinRTS, uint8_t pinCTS);
+    bool disableFlowControl();
+
+    // Slow clock mode: the module sleeps between the commands and keeps the registration and the bearer
+    // With DTR, the module sleeps after idleMs without command (checked by poll()) or on enterSleep()
+    // Without DTR, the module sleeps by itself when the serial line is idle
+    // The module is woken up automatically before each command
+    bool enableSlowClock(uint8_t pinDTR, uint16_t idleMs = 1000);
+    bool enableSlowClock();
+    bool disableSlowClock();
+    void enterSleep();
+
+    // Compact mode: no echo of the commands (ATE0) and numeric result codes (ATV0, 0 for OK and 4 for ERROR)
+    // Each exchange reads fewer bytes and the answers fit smaller buffers
+    bool enableCompactMode();
+    bool disableCompactMode();
+
     // Define the power mode (for parameter: see PowerMode enum)
     bool setPowerMode(PowerMode powerMode);
 
@@ -72,12 +245,113 @@ class SIM800L {
     bool connectGPRS();
     bool disconnectGPRS();
 
+    // Status of the GPRS bearer queried from the module (with the IP address assigned)
+    BearerStatus getBearerStatus();
+    const char* getBearerIP();
+    // Last status known of the GPRS bearer, updated from the unsolicited messages (no command sent)
+    bool isGPRSConnected();
+    // Connect the GPRS bearer only if it is not already connected (before each HTTP request if enabled)
+    bool ensureGPRS();
+    void setAutoConnectGPRS(bool enable);
+
+    // Raw TCP/UDP sockets (AT+CIPSTART), independent of the HTTP bearer
+    // In multi-connection mode, the id of the connection is 0 to SOCKET_MAX_CONNECTIONS - 1 (ignored otherwise)
+    bool setupIP(const char* apn, bool multiConnection = false);
+    bool disconnectIP();
+    bool connectSocket(uint8_t id, SocketProtocol protocol, const char* host, uint16_t port, uint16_t timeoutMs);
+    bool sendSocket(uint8_t id, const uint8_t* data, uint16_t size, uint16_t timeoutMs);
+    bool isSocketDataAvailable(uint8_t id);
+    int16_t receiveSocket(uint8_t id, uint8_t* buffer, uint16_t size);
+    bool closeSocket(uint8_t id);
+    SocketState getSocketState(uint8_t id);
+
     // HTTP methods
     uint16_t doGet(const char* url, uint16_t serverReadTimeoutMs);
     uint16_t doGet(const char* url, const char* headers, uint16_t serverReadTimeoutMs);
     uint16_t doPost(const char* url, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs);
     uint16_t doPost(const char* url, const char* headers, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs);
 
+    // HTTP HEAD, only the status, the size and the headers of the response (see setHTTPHeadersBuffer())
+    uint16_t doHead(const char* url, const char* headers, uint16_t serverReadTimeoutMs);
+
+    // HTTP POST with a payload of known size pulled by blocks from a stream or a callback (not kept in memory)
+    uint16_t doPost(const char* url, const char* headers, const char* contentType, Stream* payloadSource, uint32_t payloadSize, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs);
+    uint16_t doPost(const char* url, const char* headers, const char* contentType, HTTPPayloadCallback payloadCallback, uint32_t payloadSize, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs);
+
+    // Asynchronous HTTP methods, the request is driven by poll()
+    // The url, headers, content type and payload must remain valid until the end of the request
+    bool beginGet(const char* url, uint16_t serverReadTimeoutMs);
+    bool beginGet(const char* url, const char* headers, uint16_t serverReadTimeoutMs);
+    bool beginPost(const char* url, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs);
+    bool beginPost(const char* url, const char* headers, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs);
+    bool beginPost(const char* url, const char* headers, const char* contentType, Stream* payloadSource, uint32_t payloadSize, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs);
+    bool beginPost(const char* url, const char* headers, const char* contentType, HTTPPayloadCallback payloadCallback, uint32_t payloadSize, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs);
+    bool beginHead(const char* url, const char* headers, uint16_t serverReadTimeoutMs);
+
+    // Dispatch the unsolicited messages and execute the next step of the asynchronous HTTP request
+    // (return true while the request is ongoing)
+    bool poll();
+
+    // Status of the asynchronous HTTP request
+    HTTPState getHTTPState();
+    uint16_t getHTTPResult();
+    void setHTTPCallback(HTTPCallback callback);
+
+    // Keep the HTTP session open between requests (only URL, payload and changed parameters are sent)
+    void setPersistentSession(bool enable);
+    bool closeSession();
+
+    // Queue of HTTP requests stored in a buffer of the caller (ring buffer) and sent back-to-back
+    // in a single HTTP session, asynchronously by beginQueue() and poll() or by sendQueue()
+    void setHTTPQueue(HTTPRequest* queue, uint8_t size);
+    bool queueGet(const char* url, const char* headers, uint16_t serverReadTimeoutMs);
+    bool queuePost(const char* url, const char* headers, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs);
+    uint8_t getQueueLength();
+    bool beginQueue();
+    uint8_t sendQueue();
+    void setHTTPQueueCallback(HTTPQueueCallback callback);
+
+    // Stream the data received from HTTP by chunks to a sink and/or a callback instead of keeping it in the reception buffer
+    // (the size of the chunks is limited by the reception buffer)
+    void setHTTPDataSink(Print* sink);
+    void setHTTPDataCallback(HTTPDataCallback callback);
+    uint32_t getContentLength();
+
+    // Resumable download to the sink and/or the callback: the data is requested from an offset (Range header)
+    // and, after a failure, the download is resumed from the last byte received (the GPRS is reconnected if needed)
+    uint16_t doDownload(const char* url, uint32_t offset, uint16_t serverReadTimeoutMs, uint8_t maxAttempts = 3);
+    bool beginDownload(const char* url, uint32_t offset, uint16_t serverReadTimeoutMs);
+    uint32_t getDownloadOffset();
+    uint32_t getDownloadSize();
+
+    // Headers of the responses (AT+HTTPHEAD) read into a buffer of the caller (truncated if too small)
+    // and value of a header of the last response (i.e. "ETag"), NULL if not received
+    void setHTTPHeadersBuffer(char* buffer, uint16_t size);
+    const char* getHTTPHeader(const char* name);
+
+    // Keep the data received as is in the reception buffer (binary data, CR and LF are not filtered)
+    void setBinaryMode(bool enable);
+
+    // Counters and durations of the phases, collected without debug output
+    const DriverMetrics* getMetrics();
+    void resetMetrics();
+
+    // Queue the debug messages in a ring buffer emptied by poll() and while waiting for the module,
+    // so the console doesn't slow down the exchanges with the module (requires a debug stream)
+    // writeBlocks (optional) : for a console without availableForWrite(), write LOG_FLUSH_BLOCK_SIZE bytes at each flush
+    bool enableAsyncLog(char* buffer, uint16_t size, bool writeBlocks = false);
+    void disableAsyncLog();
+    // Write the queued debug messages accepted by the console without blocking
+    void flushLog();
+    // Number of bytes of debug messages dropped because the ring buffer was full
+    uint32_t getLogDropped();
+
+    // Define the function called while the driver is waiting for the module
+    void setIdleHook(IdleHook hook);
+
+    // Register a handler for the unsolicited messages starting with a prefix (dispatched by poll() and between commands)
+    bool addURCHandler(const char* prefix, URCHandler handler);
+
     // Obtain results after HTTP successful connections (size and buffer)
     uint16_t getDataSizeReceived();
     char* getDataReceived();
@@ -85,42 +359,143 @@ class SIM800L {
   protected:
     // Send command
     void sendCommand(const char* command);
-    // Send comment from PROGMEM
+    // Send command from PROGMEM
     void sendCommand_P(const char* command);
     // Send command with parameter within quotes (template : command"parameter")
     void sendCommand(const char* command, const char* parameter);
     // Send command with parameter within quotes from PROGMEM (template : command"parameter")
     void sendCommand_P(const char* command, const char* parameter);
+    // Send command with a numeric parameter from PROGMEM (template : command<value>)
+    void sendCommand_P(const char* command, uint32_t value);
+    // Send command with two numeric parameters from PROGMEM (template : command<value1>,<value2>)
+    void sendCommand_P(const char* command, uint32_t value1, uint32_t value2);
+    // Send command from PROGMEM built in several parts (begin, append the parameters, end)
+    void beginCommand_P(const char* command);
+    void appendCommand(const char* part);
+    void appendCommand(uint32_t value);
+    void endCommand();
 
-    // Read from module (timeout in millisec)
-    bool readResponse(uint16_t timeout, uint8_t crlfToWait = 2);
+    // Read from module (timeout in millisec) for a number of CRLF or until the line with the answer defined in PROGMEM
+    bool readResponse(uint16_t timeout, uint8_t crlfToWait = 2, const char* expectedAnswer = NULL);
     // Read from module and expect a specific answer defined in PROGMEM (timeout in millisec)
-    bool readResponseCheckAnswer_P(uint16_t timeout, const char* expectedAnswer, uint8_t crlfToWait = 2);
+    bool readResponseCheckAnswer_P(uint16_t timeout, const char* expectedAnswer);
+    // Read an exact number of bytes from module
+    bool readRawData(char* buffer, uint16_t size);
+    // Wait for data from module until the deadline
+    bool waitData(uint32_t timerStart, uint16_t timeout);
+    // Incremental matcher of the answer at the start of the lines received
+    void startMatchAnswer(const char* expectedAnswer);
+    int8_t matchAnswerChar(char c);
+
+    // Read a byte from the module (with the flow control and the metrics)
+    char readFromModule();
+
+    // Add the duration of a phase started at timerStart to the metrics
+    void recordPhase(MetricsPhase phase, uint32_t timerStart);
 
     // Purge the serial
     void purgeSerial();
 
+    // Wake up the module in slow clock mode before a command, let it sleep after idle
+    void wakeModule();
+    void sleepIfIdle();
+
+    // Write to module and manage the reception with the flow control
+    bool writeToModule(const uint8_t* data, size_t size);
+    void checkReceiveFlow();
+
+    // Read and dispatch the unsolicited messages without waiting
+    void processURC();
+    void dispatchURC(const char* line);
+    void dispatchURCLine(const char* line, uint16_t size);
+    // Start of the command sent, to tell its echo and its answer lines from the unsolicited messages
+    void keepPendingCommand(const char* command, bool progmem);
+    bool isAnswerLine(const char* line, uint16_t size);
+    void dispatchSocketURC(const char* line);
+
     // Find string in another string
     int16_t strIndex(const char* str, const char* findStr, uint16_t startIdx = 0);
 
+    // Copy of a string to detect changes (false if too long to be kept)
+    bool keepCopy(char* copy, uint8_t size, const char* str);
+
     // Manage internal buffer
     void initInternalBuffer();
     void initRecvBuffer();
+    char* copyToRecvBuffer(const char* str, int16_t size);
+
+    // Send a status query of the command table and locate the value in the answer
+    bool queryStatus(uint8_t queryId, char** value);
+
+    // Convert the status of the registration (+CREG) to the enum
+    NetworkRegistration toNetworkRegistration(char value);
+
+    // Check if AT command works within a timeout
+    bool checkLink(uint16_t timeout);
+
+    // Write and read a file of the file system of the module (C:\USER\<fileName>)
+    bool beginWriteFile(const char* fileName, bool append, uint16_t size);
+    bool readFile(const char* fileName, uint32_t position, char* buffer, uint16_t size);
+
+    // Probe the model and the firmware release of the module (only once)
+    bool probeCapabilities();
 
     // Initiate HTTP/S connection
     uint16_t initiateHTTP(const char* url, const char* headers);
     uint16_t terminateHTTP();
 
+    // Steps of the asynchronous HTTP request
+    bool startHTTP(uint8_t method, const char* url, const char* headers, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs);
+    void failHTTP(uint16_t errorRC);
+    uint16_t uploadHTTPData();
+    uint16_t parseHTTPAction();
+    uint16_t readHTTPData();
+    uint16_t readHTTPChunk();
+    uint16_t parseHTTPReadSize();
+    uint16_t readHTTPHeaders();
+    bool hasHTTPData();
+
+    // Start the request at the head of the HTTP queue and move to the next one at the end
+    bool startQueuedHTTP();
+    bool nextQueuedHTTP();
+
+    // Wait for the answer of the module on a socket (dispatched as unsolicited message)
+    bool waitSocketState(uint8_t id, SocketState pendingState, uint16_t timeout);
+
   private:
+    // Common initialization of the constructors
+    void initDriver(Stream* _stream, uint8_t _pinRst, Stream* _debugStream);
+
     // Serial line with SIM800L
     Stream* stream = NULL;
 
-    // Serial console for the debug
+    // Serial console for the debug (the ring buffer when the log is asynchronous)
     Stream* debugStream = NULL;
+    SIM800LLogBuffer logBuffer;
+    bool asyncLog = false;
 
     // Details about the circuit: pins
     uint8_t pinReset = 0;
 
+    // Hardware flow control
+    bool flowControl = false;
+    bool receiveHeld = false;
+    uint8_t pinRTS = 0;
+    uint8_t pinCTS = 0;
+
+    // Slow clock mode (0 disabled, 1 with DTR, 2 automatic)
+    uint8_t slowClockMode = 0;
+    uint8_t pinDTR = 0;
+    uint16_t slowClockIdleMs = 0;
+    bool moduleAsleep = false;
+    uint32_t lastCommandTime = 0;
+
+    // Compact mode (no echo, numeric result codes)
+    bool compactMode = false;
+
+    // Baud rate of the serial line (9600 bps by default)
+    uint32_t baudRate = 9600;
+
     // Internal memory for the shared buffer
     // Used for all reception of message from the module
     char *internalBuffer;
@@ -131,8 +506,133 @@ class SIM800L {
     uint16_t recvBufferSize = 0;
     uint16_t dataSize = 0;
 
+    // Buffers allocated by the driver (to free in the destructor)
+    bool ownBuffers = false;
+    bool binaryMode = false;
+
+    // Capabilities of the module
+    bool capabilitiesProbed = false;
+    bool sslSupported = false;
+    uint8_t firmwareRelease = 0;
+    char moduleModel[12] = "";
+
+    // Asynchronous HTTP request
+    HTTPState httpState = HTTP_IDLE;
+    uint8_t httpMethod = HTTP_METHOD_GET;
+    const char* httpUrl = NULL;
+    const char* httpHeaders = NULL;
+    const char* httpContentType = NULL;
+    const char* httpPayload = NULL;
+    Stream* httpPayloadSource = NULL;
+    HTTPPayloadCallback httpPayloadCallback = NULL;
+    uint32_t httpPayloadSize = 0;
+    uint16_t httpWriteTimeoutMs = 0;
+    uint16_t httpReadTimeoutMs = 0;
+    uint16_t httpResult = 0;
+    bool httpFailed = false;
+    uint32_t httpTimerStart = 0;
+    HTTPCallback httpCallback = NULL;
+
+    // Streaming of the data received
+    Print* httpDataSink = NULL;
+    HTTPDataCallback httpDataCallback = NULL;
+    uint32_t httpDataLength = 0;
+    uint32_t httpReadOffset = 0;
+
+    // Resumable download (offset of the first byte of the response in the resource and next byte expected)
+    bool httpDownload = false;
+    uint32_t httpRangeStart = 0;
+    uint32_t httpDownloadOffset = 0;
+    char httpRangeHeader[25];
+
+    // Part of the stored file already accepted by the server (resumed on the next upload of the same file)
+    char storedFileName[STORED_FILE_NAME_SIZE] = "";
+    uint32_t storedFileOffset = 0;
+
+    // Last file known to exist in the file system of the module (not created again before writing)
+    char existingFileName[STORED_FILE_NAME_SIZE] = "";
+
+    // Headers of the HTTP response (lines terminated by \0, the last one is empty)
+    char* httpHeadersBuffer = NULL;
+    uint16_t httpHeadersSize = 0;
+
+    // Persistent HTTP session and parameters already defined on the module
+    bool httpKeepSession = false;
+    bool httpSessionOpen = false;
+    int8_t httpSessionSSL = -1;
+    bool httpHeadersKept = false;
+    bool httpContentTypeKept = false;
+    char httpHeadersCopy[HTTP_PARAM_COPY_SIZE];
+    char httpContentTypeCopy[HTTP_PARAM_COPY_SIZE];
+
+    // Queue of HTTP requests
+    HTTPRequest* httpQueue = NULL;
+    uint8_t httpQueueSize = 0;
+    uint8_t httpQueueHead = 0;
+    uint8_t httpQueueCount = 0;
+    bool httpQueueDraining = false;
+    bool httpQueueKeepSession = false;
+    uint8_t httpQueueSucceeded = 0;
+    HTTPQueueCallback httpQueueCallback = NULL;
+
+    // GPRS bearer (last status known and IP address)
+    BearerStatus bearerStatus = BEARER_UNKNOWN;
+    char bearerIP[16] = "";
+    bool autoConnectGPRS = false;
+
+    // Raw sockets (state and data pending for each connection)
+    bool socketMultiConnection = false;
+    SocketState socketStates[SOCKET_MAX_CONNECTIONS];
+    uint8_t socketDataFlags = 0;
+    int8_t socketSendStatus = 0;
+
+    // Function called while waiting for the module
+    IdleHook idleHook = NULL;
+
+    // Unsolicited messages
+    char urcBuffer[URC_BUFFER_SIZE];
+    uint8_t urcBufferLength = 0;
+    const char* urcPrefixes[URC_MAX_HANDLERS];
+    URCHandler urcHandlers[URC_MAX_HANDLERS];
+    uint8_t urcHandlerCount = 0;
+    char pendingCommand[PENDING_COMMAND_SIZE] = "";
+
+    // Last answer of the server received (+HTTPACTION)
+    bool httpActionReceived = false;
+    uint8_t httpActionMethod = 0;
+    uint16_t httpActionStatus = 0;
+    uint32_t httpActionSize = 0;
+
+    // Progress of the matcher on the current line (-1 if the line doesn't match)
+    const char* matchAnswer = NULL;
+    int8_t matchAnswerPos = 0;
+    int8_t matchErrorPos = 0;
+    int8_t matchCMErrorPos = 0;
+    int8_t matchCodePos = 0;
+    char matchCode = '\0';
+
+    // Metrics of the driver and start of the current phase of the HTTP request
+    DriverMetrics metrics;
+    uint32_t httpPhaseStart = 0;
+
     // Enable debug mode
     bool enableDebug = false;
 };
 
+// Driver with buffers allocated statically within the instance (no dynamic allocation,
+// the memory used is known at link time when the instance is global)
+// Template parameters:
+//  INTERNAL_BUFFER_SIZE : size in bytes of the internal buffer
+//  RECV_BUFFER_SIZE : size in bytes of the reception buffer
+template<uint16_t INTERNAL_BUFFER_SIZE, uint16_t RECV_BUFFER_SIZE>
+class SIM800LStatic : public SIM800L {
+  public:
+    SIM800LStatic(Stream* _stream, uint8_t _pinRst = RESET_PIN_NOT_USED, Stream* _debugStream = NULL)
+      : SIM800L(_stream, _pinRst, staticInternalBuffer, INTERNAL_BUFFER_SIZE, staticRecvBuffer, RECV_BUFFER_SIZE, _debugStream) {}
+
+  private:
+    char staticInternalBuffer[INTERNAL_BUFFER_SIZE];
+    char staticRecvBuffer[RECV_BUFFER_SIZE];
+};
+
 #endif // _SIM800L_H_
@@ -0,0 +1,511 @@
+/********************************************************************************
+ * Arduino-SIM800L-driver                                                       *
+ * ----------------------                                                       *
+ * MQTT 3.1.1 client over the TCP sockets of the SIM800L driver                 *
+ * (CONNECT, PUBLISH QoS 0/1, SUBSCRIBE, PINGREQ)                               *
+ * Author: Olivier Staquet                                                      *
+ * Last version available on https://github.com/ostaquet/Arduino-SIM800L-driver *
+ ********************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2019 Olivier Staquet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "SIM800LMQTT.h"
+
+/**
+ * Types of the MQTT packets (first byte of the fixed header)
+ */
+const uint8_t MQTT_CONNECT = 0x10;
+const uint8_t MQTT_CONNACK = 0x20;
+const uint8_t MQTT_PUBLISH = 0x30;
+const uint8_t MQTT_PUBACK = 0x40;
+const uint8_t MQTT_SUBSCRIBE = 0x82;
+const uint8_t MQTT_SUBACK = 0x90;
+const uint8_t MQTT_PINGREQ = 0xC0;
+const uint8_t MQTT_PINGRESP = 0xD0;
+const uint8_t MQTT_DISCONNECT = 0xE0;
+
+/**
+ * Protocol name and level of MQTT 3.1.1 (start of the CONNECT packet)
+ */
+const uint8_t MQTT_PROTOCOL[] PROGMEM = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04};
+
+/**
+ * Constructor; Init the client and allocate the buffers of the packets
+ */
+SIM800LMQTT::SIM800LMQTT(SIM800L* _sim800l, uint8_t _socketId, uint16_t _bufferSize) {
+  sim800l = _sim800l;
+  socketId = _socketId;
+
+  // The buffer must hold at least the fixed header and a packet id
+  if(_bufferSize < MQTT_MAX_HEADER_SIZE + 2) {
+    return;
+  }
+  txBuffer = (uint8_t*) malloc(_bufferSize);
+  rxBuffer = (uint8_t*) malloc(_bufferSize);
+  if(txBuffer == NULL || rxBuffer == NULL) {
+    free(txBuffer);
+    free(rxBuffer);
+    txBuffer = NULL;
+    rxBuffer = NULL;
+    return;
+  }
+  bufferSize = _bufferSize;
+}
+
+/**
+ * Destructor; cleanup the memory allocated by the client
+ */
+SIM800LMQTT::~SIM800LMQTT() {
+  free(txBuffer);
+  free(rxBuffer);
+}
+
+/**
+ * Open a TCP connection to the broker and the MQTT session (clean session)
+ * The session is ready once the broker has accepted it (CONNACK)
+ */
+bool SIM800LMQTT::connect(const char* host, uint16_t port, const char* clientId, const char* username, const char* password, uint16_t _keepAliveSec, uint16_t timeoutMs) {
+  if(txBuffer == NULL) {
+    return false;
+  }
+  if(connected) {
+    disconnect();
+  }
+
+  if(!sim800l->connectSocket(socketId, SOCKET_TCP, host, port, timeoutMs)) {
+    return false;
+  }
+  rxLength = 0;
+  rxSkip = 0;
+  pingOutstanding = false;
+  keepAliveSec = _keepAliveSec;
+
+  // Variable header : protocol, flags and keep alive
+  uint16_t pos = MQTT_MAX_HEADER_SIZE;
+  if(pos + sizeof(MQTT_PROTOCOL) + 3 > bufferSize) {
+    closeSession();
+    return false;
+  }
+  memcpy_P(txBuffer + pos, MQTT_PROTOCOL, sizeof(MQTT_PROTOCOL));
+  pos += sizeof(MQTT_PROTOCOL);
+  uint8_t flags = 0x02;
+  if(username != NULL) {
+    flags |= 0x80;
+  }
+  if(password != NULL) {
+    flags |= 0x40;
+  }
+  txBuffer[pos++] = flags;
+  txBuffer[pos++] = keepAliveSec >> 8;
+  txBuffer[pos++] = keepAliveSec & 0xFF;
+
+  // Payload : client id, user name and password
+  pos = writeString(pos, clientId);
+  if(username != NULL) {
+    pos = writeString(pos, username);
+  }
+  if(password != NULL) {
+    pos = writeString(pos, password);
+  }
+  if(pos == 0) {
+    closeSession();
+    return false;
+  }
+
+  connected = true;
+  if(!sendPacket(MQTT_CONNECT, pos - MQTT_MAX_HEADER_SIZE)) {
+    return false;
+  }
+  if(!receivePackets(MQTT_CONNACK, 0, timeoutMs) || connectReturnCode != 0) {
+    closeSession();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Close the MQTT session and the TCP connection
+ */
+bool SIM800LMQTT::disconnect() {
+  if(connected) {
+    sendPacket(MQTT_DISCONNECT, 0);
+  }
+  closeSession();
+  return true;
+}
+
+/**
+ * Check if the session is open (as known from the last exchange)
+ */
+bool SIM800LMQTT::isConnected() {
+  return connected;
+}
+
+/**
+ * Return code of the broker on the last connection (0 if accepted)
+ */
+uint8_t SIM800LMQTT::getConnectReturnCode() {
+  return connectReturnCode;
+}
+
+/**
+ * Publish a message on a topic
+ * With QoS 1, wait for the acknowledgement of the broker (PUBACK); the
+ * message is not sent again if the acknowledgement is not received
+ */
+bool SIM800LMQTT::publish(const char* topic, const uint8_t* payload, uint16_t size, uint8_t qos, bool retain) {
+  if(!connected || qos > 1) {
+    return false;
+  }
+
+  uint16_t pos = writeString(MQTT_MAX_HEADER_SIZE, topic);
+  if(pos == 0) {
+    return false;
+  }
+  uint16_t packetId = 0;
+  if(qos > 0) {
+    if(pos + 2 > bufferSize) {
+      return false;
+    }
+    packetId = nextPacketId++;
+    if(nextPacketId == 0) {
+      nextPacketId = 1;
+    }
+    txBuffer[pos++] = packetId >> 8;
+    txBuffer[pos++] = packetId & 0xFF;
+  }
+
+  // The payload is copied only if it fits in the buffer (one sending),
+  // otherwise it is sent after the header
+  uint8_t header = MQTT_PUBLISH | (qos << 1) | (retain ? 0x01 : 0x00);
+  bool sent;
+  if(pos + size <= bufferSize) {
+    memcpy(txBuffer + pos, payload, size);
+    sent = sendPacket(header, pos + size - MQTT_MAX_HEADER_SIZE);
+  } else {
+    sent = sendPacket(header, pos - MQTT_MAX_HEADER_SIZE, payload, size);
+  }
+  if(!sent) {
+    return false;
+  }
+
+  if(qos == 0) {
+    return true;
+  }
+  return receivePackets(MQTT_PUBACK, packetId, DEFAULT_TIMEOUT);
+}
+
+/**
+ * Publish a string on a topic
+ */
+bool SIM800LMQTT::publish(const char* topic, const char* payload, uint8_t qos, bool retain) {
+  return publish(topic, (const uint8_t*)payload, strlen(payload), qos, retain);
+}
+
+/**
+ * Subscribe to a topic (QoS 0 or 1) and wait for the acknowledgement of the
+ * broker (SUBACK)
+ */
+bool SIM800LMQTT::subscribe(const char* topic, uint8_t qos) {
+  if(!connected || qos > 1) {
+    return false;
+  }
+
+  uint16_t packetId = nextPacketId++;
+  if(nextPacketId == 0) {
+    nextPacketId = 1;
+  }
+  uint16_t pos = MQTT_MAX_HEADER_SIZE;
+  txBuffer[pos++] = packetId >> 8;
+  txBuffer[pos++] = packetId & 0xFF;
+  pos = writeString(pos, topic);
+  if(pos == 0 || pos + 1 > bufferSize) {
+    return false;
+  }
+  txBuffer[pos++] = qos;
+
+  if(!sendPacket(MQTT_SUBSCRIBE, pos - MQTT_MAX_HEADER_SIZE)) {
+    return false;
+  }
+  if(!receivePackets(MQTT_SUBACK, packetId, DEFAULT_TIMEOUT)) {
+    return false;
+  }
+  // 0x80 is the failure of the subscription
+  return ackCode != 0x80;
+}
+
+/**
+ * Define the callback receiving the messages published on the topics
+ * subscribed
+ */
+void SIM800LMQTT::setCallback(MQTTMessageCallback callback) {
+  messageCallback = callback;
+}
+
+/**
+ * Send a PINGREQ and wait for the answer of the broker (PINGRESP)
+ */
+bool SIM800LMQTT::ping() {
+  if(!connected || !sendPacket(MQTT_PINGREQ, 0)) {
+    return false;
+  }
+  pingOutstanding = true;
+  return receivePackets(MQTT_PINGRESP, 0, DEFAULT_TIMEOUT);
+}
+
+/**
+ * Handle the packets received without waiting and send a PINGREQ when
+ * nothing has been sent during the keep alive period
+ * The session is considered lost if the previous PINGREQ is not answered
+ * within the keep alive period
+ */
+bool SIM800LMQTT::loop() {
+  if(!connected || !receivePackets(0, 0, 0)) {
+    return false;
+  }
+
+  if(keepAliveSec > 0 && millis() - lastSent >= keepAliveSec * 1000UL) {
+    if(pingOutstanding) {
+      closeSession();
+      return false;
+    }
+    if(!sendPacket(MQTT_PINGREQ, 0)) {
+      return false;
+    }
+    pingOutstanding = true;
+  }
+  return connected;
+}
+
+/**
+ * Send a packet built in the transmission buffer, the fixed header is written
+ * just before the body (MQTT_MAX_HEADER_SIZE bytes are reserved)
+ * The session is closed if the packet can't be sent
+ */
+bool SIM800LMQTT::sendPacket(uint8_t header, uint16_t length, const uint8_t* data, uint16_t dataSize) {
+  // Remaining length encoded by 7 bits (from the least significant)
+  uint32_t remaining = (uint32_t)length + dataSize;
+  uint8_t encoded[MQTT_MAX_HEADER_SIZE - 1];
+  uint8_t encodedSize = 0;
+  do {
+    encoded[encodedSize] = remaining & 0x7F;
+    remaining >>= 7;
+    if(remaining > 0) {
+      encoded[encodedSize] |= 0x80;
+    }
+    encodedSize++;
+  } while(remaining > 0);
+
+  uint8_t start = MQTT_MAX_HEADER_SIZE - 1 - encodedSize;
+  txBuffer[start] = header;
+  memcpy(txBuffer + start + 1, encoded, encodedSize);
+
+  if(!sim800l->sendSocket(socketId, txBuffer + start, 1 + encodedSize + length, DEFAULT_TIMEOUT)) {
+    closeSession();
+    return false;
+  }
+  if(data != NULL && dataSize > 0 && !sim800l->sendSocket(socketId, data, dataSize, DEFAULT_TIMEOUT)) {
+    closeSession();
+    return false;
+  }
+  lastSent = millis();
+  return true;
+}
+
+/**
+ * Write a string prefixed by its length (2 bytes) in the transmission buffer
+ * Return the position after the string or 0 if the buffer is too small
+ */
+uint16_t SIM800LMQTT::writeString(uint16_t pos, const char* str) {
+  if(pos == 0) {
+    return 0;
+  }
+  uint16_t length = strlen(str);
+  if((uint32_t)pos + 2 + length > bufferSize) {
+    return 0;
+  }
+  txBuffer[pos++] = length >> 8;
+  txBuffer[pos++] = length & 0xFF;
+  memcpy(txBuffer + pos, str, length);
+  return pos + length;
+}
+
+/**
+ * Read the data received and handle the complete packets until the expected
+ * packet (type and id if not 0) is received or the timeout
+ * With the expected type 0, only the data already available is handled and the
+ * result is false only if the session is lost
+ * The packets larger than the reception buffer are dropped
+ */
+bool SIM800LMQTT::receivePackets(uint8_t expectedType, uint16_t expectedId, uint16_t timeoutMs) {
+  ackType = 0;
+  uint32_t timerStart = millis();
+
+  while(1) {
+    // Handle the complete packets already in the buffer
+    while(rxLength >= 2) {
+      uint32_t remaining = 0;
+      uint8_t i = 1;
+      bool complete = false;
+      for(; i < rxLength && i < MQTT_MAX_HEADER_SIZE; i++) {
+        remaining |= (uint32_t)(rxBuffer[i] & 0x7F) << (7 * (i - 1));
+        if((rxBuffer[i] & 0x80) == 0) {
+          complete = true;
+          break;
+        }
+      }
+      if(!complete) {
+        if(i >= MQTT_MAX_HEADER_SIZE) {
+          // Malformed remaining length
+          closeSession();
+          return false;
+        }
+        break;
+      }
+
+      uint16_t headerSize = i + 1;
+      uint32_t total = headerSize + remaining;
+      if(total > bufferSize) {
+        rxSkip = total - rxLength;
+        rxLength = 0;
+        break;
+      }
+      if(rxLength < total) {
+        break;
+      }
+
+      handlePacket(rxBuffer[0], rxBuffer + headerSize, remaining);
+      rxLength -= total;
+      memmove(rxBuffer, rxBuffer + total, rxLength);
+
+      if(expectedType != 0 && ackType == expectedType && (expectedId == 0 || ackId == expectedId)) {
+        return true;
+      }
+    }
+
+    if(!connected || sim800l->getSocketState(socketId) != SOCKET_CONNECTED) {
+      if(connected) {
+        closeSession();
+      }
+      return false;
+    }
+
+    if(sim800l->isSocketDataAvailable(socketId)) {
+      if(!fillBuffer()) {
+        closeSession();
+        return false;
+      }
+      continue;
+    }
+
+    if(expectedType == 0) {
+      return true;
+    }
+    if(millis() - timerStart > timeoutMs) {
+      return false;
+    }
+  }
+}
+
+/**
+ * Append the data pending on the connection to the reception buffer, the
+ * bytes of the packets too large are dropped
+ */
+bool SIM800LMQTT::fillBuffer() {
+  int16_t size = sim800l->receiveSocket(socketId, rxBuffer + rxLength, bufferSize - rxLength);
+  if(size < 0) {
+    return false;
+  }
+
+  if(rxSkip > 0) {
+    uint16_t drop = (uint32_t)size < rxSkip ? size : rxSkip;
+    memmove(rxBuffer + rxLength, rxBuffer + rxLength + drop, size - drop);
+    size -= drop;
+    rxSkip -= drop;
+  }
+  rxLength += size;
+  return true;
+}
+
+/**
+ * Handle a packet received from the broker (body after the fixed header)
+ */
+void SIM800LMQTT::handlePacket(uint8_t header, uint8_t* body, uint16_t length) {
+  switch(header & 0xF0) {
+    case MQTT_CONNACK:
+      if(length >= 2) {
+        connectReturnCode = body[1];
+        ackType = MQTT_CONNACK;
+      }
+      break;
+
+    case MQTT_PUBLISH: {
+      if(length < 2) {
+        return;
+      }
+      uint16_t topicLength = (body[0] << 8) | body[1];
+      uint8_t qos = (header >> 1) & 0x03;
+      uint16_t pos = 2 + topicLength + (qos > 0 ? 2 : 0);
+      if(pos > length) {
+        return;
+      }
+      uint16_t packetId = qos > 0 ? (body[2 + topicLength] << 8) | body[3 + topicLength] : 0;
+
+      // Move the topic on its length to terminate it with \0 in the buffer
+      memmove(body + 1, body + 2, topicLength);
+      body[1 + topicLength] = '\0';
+      if(messageCallback != NULL) {
+        messageCallback(this, (const char*)(body + 1), body + pos, length - pos);
+      }
+
+      if(qos == 1) {
+        txBuffer[MQTT_MAX_HEADER_SIZE] = packetId >> 8;
+        txBuffer[MQTT_MAX_HEADER_SIZE + 1] = packetId & 0xFF;
+        sendPacket(MQTT_PUBACK, 2);
+      }
+      break;
+    }
+
+    case MQTT_PUBACK:
+    case MQTT_SUBACK:
+      if(length >= 2) {
+        ackType = header & 0xF0;
+        ackId = (body[0] << 8) | body[1];
+        ackCode = length >= 3 ? body[2] : 0;
+      }
+      break;
+
+    case MQTT_PINGRESP:
+      pingOutstanding = false;
+      ackType = MQTT_PINGRESP;
+      break;
+  }
+}
+
+/**
+ * Mark the session as lost and close the TCP connection
+ */
+void SIM800LMQTT::closeSession() {
+  connected = false;
+  pingOutstanding = false;
+  sim800l->closeSocket(socketId);
+}
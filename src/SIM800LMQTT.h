@@ -0,0 +1,120 @@
+/********************************************************************************
+ * Arduino-SIM800L-driver                                                       *
+ * ----------------------                                                       *
+ * MQTT 3.1.1 client over the TCP sockets of the SIM800L driver                 *
+ * (CONNECT, PUBLISH QoS 0/1, SUBSCRIBE, PINGREQ)                               *
+ * Author: Olivier Staquet                                                      *
+ * Last version available on https://github.com/ostaquet/Arduino-SIM800L-driver *
+ ********************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2019 Olivier Staquet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef _SIM800L_MQTT_H_
+#define _SIM800L_MQTT_H_
+
+#include <Arduino.h>
+#include "SIM800L.h"
+
+#define MQTT_DEFAULT_KEEP_ALIVE 60
+#define MQTT_MAX_HEADER_SIZE 5
+
+class SIM800LMQTT;
+
+// Callback receiving the messages published on the topics subscribed
+typedef void (*MQTTMessageCallback)(SIM800LMQTT* mqtt, const char* topic, const uint8_t* payload, uint16_t size);
+
+class SIM800LMQTT {
+  public:
+    // Initialize the client
+    // Parameters:
+    //  _sim800l : driver of the module (the IP context must be setup with setupIP())
+    //  _socketId (optional) : id of the connection used in multi-connection mode
+    //  _bufferSize (optional) : size in bytes of the transmission and of the reception buffers (max packet size)
+    SIM800LMQTT(SIM800L* _sim800l, uint8_t _socketId = 0, uint16_t _bufferSize = 128);
+    ~SIM800LMQTT();
+
+    // Open the session with the broker (clean session, user name and password are optional)
+    bool connect(const char* host, uint16_t port, const char* clientId, const char* username = NULL, const char* password = NULL, uint16_t keepAliveSec = MQTT_DEFAULT_KEEP_ALIVE, uint16_t timeoutMs = 20000);
+    bool disconnect();
+    bool isConnected();
+    // Return code of the last CONNACK (0 if accepted)
+    uint8_t getConnectReturnCode();
+
+    // Publish a message (with QoS 1, wait for the acknowledgement of the broker)
+    bool publish(const char* topic, const uint8_t* payload, uint16_t size, uint8_t qos = 0, bool retain = false);
+    bool publish(const char* topic, const char* payload, uint8_t qos = 0, bool retain = false);
+
+    // Subscribe to a topic, the messages are given to the callback by loop()
+    // (the callback can publish with QoS 0 only)
+    bool subscribe(const char* topic, uint8_t qos = 0);
+    void setCallback(MQTTMessageCallback callback);
+
+    // Check the broker
+    bool ping();
+
+    // Dispatch the messages received and keep the session alive (return false if the session is lost)
+    bool loop();
+
+  protected:
+    // Send the packet built in the transmission buffer (body after MQTT_MAX_HEADER_SIZE bytes)
+    // followed by optional data sent as is (i.e. a payload too large for the buffer)
+    bool sendPacket(uint8_t header, uint16_t length, const uint8_t* data = NULL, uint16_t dataSize = 0);
+    // Write a string with its length in the transmission buffer (return the next position or 0 on overflow)
+    uint16_t writeString(uint16_t pos, const char* str);
+
+    // Read and handle the packets received until the expected one (type 0 to read only the data available)
+    bool receivePackets(uint8_t expectedType, uint16_t expectedId, uint16_t timeoutMs);
+    bool fillBuffer();
+    void handlePacket(uint8_t header, uint8_t* body, uint16_t length);
+
+    // Mark the session as lost and close the connection
+    void closeSession();
+
+  private:
+    // Driver of the module and connection used
+    SIM800L* sim800l = NULL;
+    uint8_t socketId = 0;
+
+    // Buffers of the packets (same size for transmission and reception)
+    uint8_t* txBuffer = NULL;
+    uint8_t* rxBuffer = NULL;
+    uint16_t bufferSize = 0;
+    uint16_t rxLength = 0;
+    uint32_t rxSkip = 0;
+
+    // Session
+    bool connected = false;
+    uint8_t connectReturnCode = 0;
+    uint16_t keepAliveSec = MQTT_DEFAULT_KEEP_ALIVE;
+    uint32_t lastSent = 0;
+    bool pingOutstanding = false;
+    uint16_t nextPacketId = 1;
+
+    // Last acknowledgement received (packet type and id)
+    uint8_t ackType = 0;
+    uint16_t ackId = 0;
+    uint8_t ackCode = 0;
+
+    MQTTMessageCallback messageCallback = NULL;
+};
+
+#endif // _SIM800L_MQTT_H_
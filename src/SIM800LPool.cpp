@@ -0,0 +1,262 @@
+/********************************************************************************
+ * Arduino-SIM800L-driver                                                       *
+ * ----------------------                                                       *
+ * Scheduler of HTTP requests across several SIM800L modules                    *
+ * (round-robin, load balancing and failover)                                   *
+ * Author: Olivier Staquet                                                      *
+ * Last version available on https://github.com/ostaquet/Arduino-SIM800L-driver *
+ ********************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2019 Olivier Staquet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#include "SIM800LPool.h"
+
+/**
+ * Add a module to the pool, its registration is checked before sending a
+ * request (max POOL_MAX_MODULES modules)
+ */
+bool SIM800LPool::addModule(SIM800L* sim800l) {
+  if(sim800l == NULL || moduleCount >= POOL_MAX_MODULES) {
+    return false;
+  }
+
+  PoolModule* module = &modules[moduleCount++];
+  memset(module, 0, sizeof(PoolModule));
+  module->sim800l = sim800l;
+  module->checkDue = true;
+  return true;
+}
+
+/**
+ * Number of modules in the pool
+ */
+uint8_t SIM800LPool::getModuleCount() {
+  return moduleCount;
+}
+
+/**
+ * Driver of a module of the pool (NULL if the index is invalid)
+ */
+SIM800L* SIM800LPool::getModule(uint8_t index) {
+  return index < moduleCount ? modules[index].sim800l : NULL;
+}
+
+/**
+ * True if the module was registered at the last check and didn't fail since
+ */
+bool SIM800LPool::isModuleAvailable(uint8_t index) {
+  return index < moduleCount && modules[index].available;
+}
+
+/**
+ * Define the buffer of the caller storing the queue of HTTP requests
+ * (ring buffer of size requests, the requests already queued are dropped)
+ */
+void SIM800LPool::setHTTPQueue(HTTPRequest* queue, uint8_t size) {
+  httpQueue = queue;
+  httpQueueSize = queue != NULL ? size : 0;
+  httpQueueHead = 0;
+  httpQueueCount = 0;
+}
+
+/**
+ * Add an HTTP/S GET at the end of the queue
+ * Return false if the queue is full
+ */
+bool SIM800LPool::queueGet(const char* url, const char* headers, uint16_t serverReadTimeoutMs) {
+  return queuePost(url, headers, NULL, NULL, 0, serverReadTimeoutMs);
+}
+
+/**
+ * Add an HTTP/S POST at the end of the queue (GET if the content type is NULL)
+ * Return false if the queue is full
+ */
+bool SIM800LPool::queuePost(const char* url, const char* headers, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs) {
+  if(httpQueueCount >= httpQueueSize) {
+    return false;
+  }
+
+  HTTPRequest* request = &httpQueue[(httpQueueHead + httpQueueCount) % httpQueueSize];
+  request->url = url;
+  request->headers = headers;
+  request->contentType = contentType;
+  request->payload = payload;
+  request->clientWriteTimeoutMs = clientWriteTimeoutMs;
+  request->serverReadTimeoutMs = serverReadTimeoutMs;
+  httpQueueCount++;
+  return true;
+}
+
+/**
+ * Number of requests waiting in the queue, ongoing on a module or waiting
+ * for another module after a failure
+ */
+uint8_t SIM800LPool::getQueueLength() {
+  uint8_t count = httpQueueCount;
+  for(uint8_t i = 0; i < moduleCount; i++) {
+    if(modules[i].busy || modules[i].pendingRetry) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * Define the callback receiving the result of each request, with the driver
+ * of the module which sent it
+ */
+void SIM800LPool::setHTTPQueueCallback(HTTPQueueCallback callback) {
+  httpQueueCallback = callback;
+}
+
+/**
+ * Define the delay between the checks of the registration of the modules
+ * (the modules are also checked after a failure)
+ */
+void SIM800LPool::setHealthCheckInterval(uint32_t intervalMs) {
+  healthCheckInterval = intervalMs;
+}
+
+/**
+ * Service the modules: one step of the request of each module round-robin
+ * (the wait of the servers overlaps between the modules), the check of one
+ * idle module if needed, then the next requests to the idle modules
+ * Return true while requests are waiting or ongoing
+ */
+bool SIM800LPool::poll() {
+  if(moduleCount == 0) {
+    return false;
+  }
+
+  // One step on each module, starting by another module at each call
+  for(uint8_t n = 0; n < moduleCount; n++) {
+    uint8_t i = (nextModule + n) % moduleCount;
+    bool ongoing = modules[i].sim800l->poll();
+    if(modules[i].busy && !ongoing) {
+      finishRequest(i, modules[i].sim800l->getHTTPResult());
+    }
+  }
+
+  // Check the registration of one idle module (a blocking exchange)
+  uint32_t now = millis();
+  for(uint8_t n = 0; n < moduleCount; n++) {
+    uint8_t i = (nextModule + n) % moduleCount;
+    PoolModule* module = &modules[i];
+    if(!module->busy && (module->checkDue || now - module->lastCheck >= healthCheckInterval)) {
+      checkModule(i);
+      break;
+    }
+  }
+
+  // Give the next requests to the idle modules available
+  for(uint8_t n = 0; n < moduleCount; n++) {
+    uint8_t i = (nextModule + n) % moduleCount;
+    if(!modules[i].busy && modules[i].available) {
+      dispatch(i);
+    }
+  }
+
+  nextModule = (nextModule + 1) % moduleCount;
+  return getQueueLength() > 0;
+}
+
+/**
+ * Check the registration of a module on the network, the module is not used
+ * while it is not registered (home network or roaming)
+ */
+void SIM800LPool::checkModule(uint8_t index) {
+  PoolModule* module = &modules[index];
+  NetworkRegistration registration = module->sim800l->getRegistrationStatus();
+  module->available = registration == REGISTERED_HOME || registration == REGISTERED_ROAMING;
+  module->checkDue = false;
+  module->lastCheck = millis();
+}
+
+/**
+ * Start a request on an idle module: a request failed on a module is sent
+ * again first, then the head of the queue
+ * Return false if there is nothing to send or if the module refused it
+ */
+bool SIM800LPool::dispatch(uint8_t index) {
+  PoolModule* module = &modules[index];
+
+  // The module sends again its own request first (its slot is reused otherwise)
+  PoolModule* failedModule = module->pendingRetry ? module : NULL;
+  for(uint8_t i = 0; i < moduleCount && failedModule == NULL; i++) {
+    if(modules[i].pendingRetry) {
+      failedModule = &modules[i];
+    }
+  }
+
+  if(failedModule != NULL) {
+    module->request = failedModule->request;
+    module->attempts = failedModule->attempts;
+    failedModule->pendingRetry = false;
+  } else if(httpQueueCount > 0) {
+    module->request = httpQueue[httpQueueHead];
+    module->attempts = 0;
+    httpQueueHead = (httpQueueHead + 1) % httpQueueSize;
+    httpQueueCount--;
+  } else {
+    return false;
+  }
+
+  module->attempts++;
+  HTTPRequest* request = &module->request;
+  bool started;
+  if(request->contentType != NULL) {
+    started = module->sim800l->beginPost(request->url, request->headers, request->contentType, request->payload, request->clientWriteTimeoutMs, request->serverReadTimeoutMs);
+  } else {
+    started = module->sim800l->beginGet(request->url, request->headers, request->serverReadTimeoutMs);
+  }
+  if(!started) {
+    finishRequest(index, 700);
+    return false;
+  }
+  module->busy = true;
+  return true;
+}
+
+/**
+ * Handle the end of the request of a module; after an error of the module
+ * or of the network (60x and error codes of the driver), the module is
+ * checked again and the request is sent by the next module available
+ * (at most POOL_MAX_ATTEMPTS times), otherwise the result is given to the
+ * callback
+ */
+void SIM800LPool::finishRequest(uint8_t index, uint16_t httpRC) {
+  PoolModule* module = &modules[index];
+  module->busy = false;
+
+  if(httpRC == 0 || httpRC >= 600) {
+    module->available = false;
+    module->checkDue = true;
+    if(module->attempts < POOL_MAX_ATTEMPTS) {
+      module->pendingRetry = true;
+      return;
+    }
+  }
+
+  if(httpQueueCallback != NULL) {
+    httpQueueCallback(module->sim800l, &module->request, httpRC);
+  }
+}
@@ -0,0 +1,102 @@
+/********************************************************************************
+ * Arduino-SIM800L-driver                                                       *
+ * ----------------------                                                       *
+ * Scheduler of HTTP requests across several SIM800L modules                    *
+ * (round-robin, load balancing and failover)                                   *
+ * Author: Olivier Staquet                                                      *
+ * Last version available on https://github.com/ostaquet/Arduino-SIM800L-driver *
+ ********************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2019 Olivier Staquet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+#ifndef _SIM800L_POOL_H_
+#define _SIM800L_POOL_H_
+
+#include <Arduino.h>
+#include "SIM800L.h"
+
+#define POOL_MAX_MODULES 4
+#define POOL_MAX_ATTEMPTS 3
+#define POOL_HEALTH_CHECK_INTERVAL 30000
+
+// State of a module of the pool
+struct PoolModule {
+  SIM800L* sim800l;
+  bool available;        // Registered at the last check and not failing
+  bool checkDue;         // Registration to check at the next poll (new module or failure)
+  uint32_t lastCheck;
+  bool busy;             // Request ongoing on the module
+  bool pendingRetry;     // Request failed, waiting for a module to send it again
+  HTTPRequest request;   // Request sent by the module
+  uint8_t attempts;
+};
+
+class SIM800LPool {
+  public:
+    // Add a module to the pool (the module must be setup and its GPRS connectivity
+    // managed, i.e. with setAutoConnectGPRS(true))
+    bool addModule(SIM800L* sim800l);
+    uint8_t getModuleCount();
+    SIM800L* getModule(uint8_t index);
+    // Module registered on the network at the last check and not failing
+    bool isModuleAvailable(uint8_t index);
+
+    // Queue of HTTP requests stored in a buffer of the caller (ring buffer), dispatched to the modules available
+    void setHTTPQueue(HTTPRequest* queue, uint8_t size);
+    bool queueGet(const char* url, const char* headers, uint16_t serverReadTimeoutMs);
+    bool queuePost(const char* url, const char* headers, const char* contentType, const char* payload, uint16_t clientWriteTimeoutMs, uint16_t serverReadTimeoutMs);
+    // Requests waiting in the queue or ongoing on a module
+    uint8_t getQueueLength();
+    // Callback receiving the result of each request with the module which sent it
+    void setHTTPQueueCallback(HTTPQueueCallback callback);
+
+    // Delay between the checks of the registration of the idle modules
+    void setHealthCheckInterval(uint32_t intervalMs);
+
+    // Execute one step of each module round-robin, check the modules and dispatch the requests
+    // (return true while requests are waiting or ongoing)
+    bool poll();
+
+  protected:
+    // Check the registration of a module (switched to unavailable if not registered)
+    void checkModule(uint8_t index);
+    // Start the next request on an idle module
+    bool dispatch(uint8_t index);
+    // Handle the end of the request of a module (callback or failover)
+    void finishRequest(uint8_t index, uint16_t httpRC);
+
+  private:
+    // Modules of the pool
+    PoolModule modules[POOL_MAX_MODULES];
+    uint8_t moduleCount = 0;
+    uint8_t nextModule = 0;
+    uint32_t healthCheckInterval = POOL_HEALTH_CHECK_INTERVAL;
+
+    // Queue of the requests (buffer of the caller)
+    HTTPRequest* httpQueue = NULL;
+    uint8_t httpQueueSize = 0;
+    uint8_t httpQueueHead = 0;
+    uint8_t httpQueueCount = 0;
+    HTTPQueueCallback httpQueueCallback = NULL;
+};
+
+#endif // _SIM800L_POOL_H_